@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace rxweb {
+
+  enum class capture_kind : std::uint8_t {
+    http = 0,
+    ws = 1
+  };
+
+  struct capture_record {
+    capture_kind kind = capture_kind::http;
+    // Microseconds since the capture started.
+    std::uint64_t offset = 0;
+    // WebSocket connection id. 0 for HTTP, where requests are replayed independently.
+    std::uint64_t connection = 0;
+    std::string method;
+    std::string path;
+    std::string body;
+  };
+
+  /*
+    Compact binary traffic log.
+    File: "RXWC" + version byte, then records of
+      kind:u8, offset:varint, connection:varint, method, path, body
+    where strings are varint length + bytes.
+  */
+  class capture_writer {
+    using Clock = std::chrono::steady_clock;
+
+  public:
+    explicit capture_writer(const std::string& file) : out(file, std::ios::binary | std::ios::trunc), started(Clock::now()) {
+      if (!out) throw std::runtime_error("Cannot open capture file " + file);
+      out.write("RXWC\x01", 5);
+    }
+
+    void record(capture_kind kind, std::uint64_t connection, const std::string& method, const std::string& path, const std::string& body) {
+      // Timestamped under the lock so offsets in the log never go backwards.
+      std::lock_guard<std::mutex> lock(mtx);
+      auto offset = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count();
+      out.put(static_cast<char>(kind));
+      writeVarint(static_cast<std::uint64_t>(offset));
+      writeVarint(connection);
+      writeString(method);
+      writeString(path);
+      writeString(body);
+    }
+
+    void flush() {
+      std::lock_guard<std::mutex> lock(mtx);
+      out.flush();
+    }
+
+  private:
+    std::mutex mtx;
+    std::ofstream out;
+    Clock::time_point started;
+
+    void writeVarint(std::uint64_t v) {
+      while (v >= 0x80) {
+        out.put(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+      }
+      out.put(static_cast<char>(v));
+    }
+
+    void writeString(const std::string& s) {
+      writeVarint(s.size());
+      out.write(s.data(), s.size());
+    }
+  };
+
+  class capture_reader {
+  public:
+    explicit capture_reader(const std::string& file) : in(file, std::ios::binary) {
+      char magic[5];
+      if (!in.read(magic, 5) || std::string(magic, 4) != "RXWC" || magic[4] != 1) {
+        throw std::runtime_error("Not a capture file " + file);
+      }
+    }
+
+    // Returns false at the end of the log. A truncated trailing record is ignored.
+    bool next(capture_record& r) {
+      auto kind = in.get();
+      if (kind == std::char_traits<char>::eof()) return false;
+      r.kind = static_cast<capture_kind>(kind);
+      return readVarint(r.offset) && readVarint(r.connection) && readString(r.method) && readString(r.path) && readString(r.body);
+    }
+
+  private:
+    std::ifstream in;
+
+    bool readVarint(std::uint64_t& v) {
+      v = 0;
+      for (int shift = 0; shift < 64; shift += 7) {
+        auto c = in.get();
+        if (c == std::char_traits<char>::eof()) return false;
+        v |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+      }
+      return false;
+    }
+
+    bool readString(std::string& s) {
+      std::uint64_t size;
+      if (!readVarint(size)) return false;
+      s.resize(size);
+      return size == 0 || static_cast<bool>(in.read(&s[0], size));
+    }
+  };
+}
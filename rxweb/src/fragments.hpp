@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace rxweb {
+
+  // Writes the next chunk of an outbound message. Returns true if more chunks follow.
+  using fragment_generator = std::function<bool(std::ostream&)>;
+
+  // Streams a file in chunks; only one chunk is in memory at a time.
+  inline fragment_generator file_fragments(const std::string& path, std::size_t chunkSize = 64 * 1024) {
+    auto in = std::make_shared<std::ifstream>(path, std::ios::binary);
+    if (!*in) throw std::runtime_error("Cannot open " + path);
+    auto buffer = std::make_shared<std::vector<char>>(chunkSize);
+
+    return [in, buffer](std::ostream& out) {
+      in->read(buffer->data(), buffer->size());
+      out.write(buffer->data(), in->gcount());
+      return in->peek() != std::char_traits<char>::eof();
+    };
+  }
+
+  // Splits a string that is already in memory without copying it whole again.
+  inline fragment_generator string_fragments(std::shared_ptr<const std::string> s, std::size_t chunkSize = 64 * 1024) {
+    auto offset = std::make_shared<std::size_t>(0);
+
+    return [s, offset, chunkSize](std::ostream& out) {
+      auto n = std::min(chunkSize, s->size() - *offset);
+      out.write(s->data() + *offset, n);
+      *offset += n;
+      return *offset < s->size();
+    };
+  }
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rxweb {
+
+  // Lower value is served first.
+  enum class priority_class : std::size_t {
+    critical = 0,
+    normal = 1,
+    bulk = 2
+  };
+
+  static const std::size_t priority_lane_count = 3;
+
+  inline priority_class higher(priority_class a, priority_class b) {
+    return static_cast<std::size_t>(a) < static_cast<std::size_t>(b) ? a : b;
+  }
+
+  enum class lane_policy {
+    // Always drain the highest non-empty lane first.
+    strict,
+    // Weighted round robin: each lane gets `weights[lane]` tasks per round.
+    weighted
+  };
+
+  struct lane_stats {
+    std::atomic<std::uint64_t> dispatched{ 0 };
+    std::atomic<std::uint64_t> waitNanos{ 0 };
+    std::atomic<std::uint64_t> maxWaitNanos{ 0 };
+  };
+
+  /*
+    Priority lanes in front of the subject.
+    Tasks are queued per priority class and a fixed set of workers pick the next one by policy.
+    Time spent queued is recorded per lane.
+    With a key function every worker gets its own shard of lanes and items with the same key always
+    go to the same shard, so they are run one at a time and in order, e.g. messages of one connection.
+    That order holds across classes: an item is queued in the lane of its key's least urgent queued
+    item if that is below its own class, and a worker that picks an item whose key has an earlier one
+    in another lane runs the earlier one instead. So a critical item overtakes other keys' items but
+    waits behind its own key's.
+  */
+  template<typename Item>
+  class lanes {
+    using Clock = std::chrono::steady_clock;
+
+    struct entry {
+      Item item;
+      Clock::time_point enqueued;
+      // Keyed lanes only.
+      std::size_t key;
+      std::uint64_t seq;
+    };
+
+    struct shard {
+      std::mutex mtx;
+      std::condition_variable cv;
+      std::array<std::deque<entry>, priority_lane_count> queues;
+      std::array<unsigned, priority_lane_count> credits{ { 0, 0, 0 } };
+      bool stopping = false;
+      // Keyed lanes: queued items per key and lane, and push order.
+      std::unordered_map<std::size_t, std::array<std::size_t, priority_lane_count>> keyed;
+      std::uint64_t seq = 0;
+    };
+
+  public:
+    using KeyFunc = std::function<std::size_t(const Item&)>;
+
+    lane_policy policy = lane_policy::weighted;
+    std::array<unsigned, priority_lane_count> weights{ { 8, 4, 1 } };
+    std::array<lane_stats, priority_lane_count> stats;
+
+    ~lanes() {
+      stop();
+    }
+
+    void start(std::size_t workers, std::function<void(Item&)> run, KeyFunc key_ = nullptr) {
+      key = key_;
+      auto n = key ? workers : 1;
+      for (std::size_t i = 0; i < n; ++i) {
+        shards.emplace_back(new shard());
+        shards.back()->credits = weights;
+      }
+      for (std::size_t i = 0; i < workers; ++i) {
+        auto sh = shards[key ? i : 0].get();
+        threads.emplace_back([this, sh, run]() {
+          entry e;
+          while (pop(*sh, e)) {
+            run(e.item);
+          }
+        });
+      }
+    }
+
+    void stop() {
+      for (auto& sh : shards) {
+        {
+          std::lock_guard<std::mutex> lock(sh->mtx);
+          sh->stopping = true;
+        }
+        sh->cv.notify_all();
+      }
+      for (auto& t : threads) {
+        if (t.joinable()) t.join();
+      }
+      threads.clear();
+    }
+
+    // Only valid while running.
+    void push(priority_class p, Item item) {
+      auto k = key ? key(item) : 0;
+      auto& sh = *shards[k % shards.size()];
+      auto lane = static_cast<std::size_t>(p);
+      {
+        std::lock_guard<std::mutex> lock(sh.mtx);
+        if (key) {
+          // Not ahead of this key's own queued items.
+          auto& counts = sh.keyed[k];
+          for (auto i = lane + 1; i < priority_lane_count; ++i) {
+            if (counts[i] > 0) lane = i;
+          }
+          ++counts[lane];
+        }
+        sh.queues[lane].push_back(entry{ std::move(item), Clock::now(), k, sh.seq++ });
+      }
+      sh.cv.notify_one();
+    }
+
+    std::size_t depth(priority_class p) {
+      std::size_t n = 0;
+      for (auto& sh : shards) {
+        std::lock_guard<std::mutex> lock(sh->mtx);
+        n += sh->queues[static_cast<std::size_t>(p)].size();
+      }
+      return n;
+    }
+
+    bool running() const {
+      return !threads.empty();
+    }
+
+  private:
+    std::vector<std::unique_ptr<shard>> shards;
+    KeyFunc key;
+    std::vector<std::thread> threads;
+
+    bool pop(shard& sh, entry& e) {
+      std::unique_lock<std::mutex> lock(sh.mtx);
+      sh.cv.wait(lock, [&sh]() { return sh.stopping || !empty(sh); });
+      if (sh.stopping) return false;
+
+      auto lane = take(sh, next(sh), e);
+      lock.unlock();
+
+      auto wait = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - e.enqueued).count());
+      auto& s = stats[lane];
+      ++s.dispatched;
+      s.waitNanos += wait;
+      auto m = s.maxWaitNanos.load();
+      while (wait > m && !s.maxWaitNanos.compare_exchange_weak(m, wait)) {}
+      return true;
+    }
+
+    // Caller holds the shard's mutex.
+    static bool empty(const shard& sh) {
+      for (auto& q : sh.queues) {
+        if (!q.empty()) return false;
+      }
+      return true;
+    }
+
+    // Moves the front of `lane` into e, or with a key, its key's earliest queued item. Returns the lane it came from.
+    // Caller holds the shard's mutex.
+    std::size_t take(shard& sh, std::size_t lane, entry& e) {
+      auto from = lane;
+      auto pos = sh.queues[lane].begin();
+      if (key) {
+        auto k = pos->key;
+        auto& counts = sh.keyed[k];
+        for (std::size_t i = 0; i < priority_lane_count; ++i) {
+          if (i == lane || counts[i] == 0) continue;
+          // Items of one key are in push order within a lane, so the first one found is that lane's earliest.
+          auto it = std::find_if(sh.queues[i].begin(), sh.queues[i].end(), [k](const entry& x) { return x.key == k; });
+          if (it->seq < pos->seq) {
+            pos = it;
+            from = i;
+          }
+        }
+        if (--counts[from] == 0 && counts == std::array<std::size_t, priority_lane_count>{ { 0, 0, 0 } }) sh.keyed.erase(k);
+      }
+      e = std::move(*pos);
+      sh.queues[from].erase(pos);
+      return from;
+    }
+
+    // Caller holds the shard's mutex and at least one lane is non-empty.
+    std::size_t next(shard& sh) {
+      if (policy == lane_policy::weighted) {
+        for (int round = 0; round < 2; ++round) {
+          for (std::size_t i = 0; i < priority_lane_count; ++i) {
+            if (!sh.queues[i].empty() && sh.credits[i] > 0) {
+              --sh.credits[i];
+              return i;
+            }
+          }
+          sh.credits = weights;
+        }
+      }
+      // Strict, or every non-empty lane has a zero weight.
+      std::size_t i = 0;
+      while (sh.queues[i].empty()) ++i;
+      return i;
+    }
+  };
+}
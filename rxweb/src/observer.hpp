@@ -16,6 +16,13 @@ namespace rxweb {
       _observer = o.observe_on(RxEventLoop)
         .filter(filterFunc);
     }
+
+    // Observe on a given coordination, e.g. identity_current_thread() when priority lanes already own the threads.
+    template<class Coordination>
+    explicit observer(Observable o, FilterFunc filterFunc, Coordination cn) {
+      _observer = o.observe_on(cn)
+        .filter(filterFunc);
+    }
     
     template<class... ArgN>
     void subscribe(ArgN&&... an) {
@@ -43,6 +50,12 @@ namespace rxweb {
         .filter(filterFunc);
     }
 
+    template<class Coordination>
+    explicit wsobserver(Observable o, FilterFunc filterFunc, Coordination cn) {
+      _observer = o.observe_on(cn)
+        .filter(filterFunc);
+    }
+
     template<class Arg0>
     void subscribe(Arg0&& a0) {
       _observer.subscribe(a0);
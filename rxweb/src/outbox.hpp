@@ -0,0 +1,252 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "server_ws.hpp"
+#include "rxweb/src/rxweb.hpp"
+#include "rxweb/src/fragments.hpp"
+#include "rxweb/src/stream_pool.hpp"
+
+namespace rxweb {
+
+  // What to do when a connection's outbound queue reaches the high-water mark.
+  enum class slow_consumer_policy {
+    // Discard the new frame.
+    drop,
+    // Replace the queued frame with the same key, otherwise discard the oldest frame.
+    conflate,
+    // Close the connection.
+    disconnect
+  };
+
+  struct outbox_stats {
+    std::atomic<std::uint64_t> queued{ 0 };
+    std::atomic<std::uint64_t> sent{ 0 };
+    std::atomic<std::uint64_t> dropped{ 0 };
+    std::atomic<std::uint64_t> conflated{ 0 };
+    std::atomic<std::uint64_t> disconnected{ 0 };
+    std::atomic<std::uint64_t> maxDepth{ 0 };
+  };
+
+  /*
+    Per-connection outbound queue, for flow control only: SimpleWeb still writes each frame on its own.
+    Frames are handed to the connection as soon as they arrive, up to highWaterMark unwritten frames.
+    Past that they wait here, and once highWaterMark frames are waiting the slow consumer policy applies.
+    A fragmented message holds the connection until its last fragment is written; the next fragment
+    is only generated once the previous one is sent, so at most one fragment is buffered. That makes the
+    generator run inside SimpleWeb's write handler on an io thread, so a blocking generator such as
+    file_fragments stalls that thread's other connections while it reads.
+  */
+  template<typename T>
+  class outbox : public std::enable_shared_from_this<outbox<T>> {
+    using SocketType = SimpleWeb::SocketServerBase<T>;
+
+    struct frame {
+      string key;
+      shared_ptr<typename SocketType::SendStream> stream;
+      unsigned char fin_rsv_opcode;
+      // Set for fragmented messages.
+      fragment_generator generator;
+      // Expected fragment size, used to lease fragment streams from the right size class.
+      std::size_t chunkSize;
+    };
+
+  public:
+    outbox(
+      shared_ptr<typename SocketType::Connection> conn,
+      outbox_stats& stats_,
+      stream_pool<typename SocketType::SendStream>& pool_,
+      std::size_t highWaterMark_,
+      slow_consumer_policy policy_
+    ) : connection(conn), stats(stats_), pool(pool_), highWaterMark(highWaterMark_), policy(policy_) {}
+
+    void push(shared_ptr<typename SocketType::SendStream> stream, const string& key = "", unsigned char fin_rsv_opcode = 129) {
+      push(frame{ key, stream, fin_rsv_opcode, nullptr, 0 });
+    }
+
+    // Queue a message sent as fragments pulled from the generator. 129 for text, 130 for binary.
+    void push(fragment_generator generator, unsigned char fin_rsv_opcode = 129, std::size_t chunkSize = 64 * 1024) {
+      push(frame{ "", nullptr, fin_rsv_opcode, generator, chunkSize });
+    }
+
+    // Frames waiting plus frames handed to the connection but not yet written.
+    std::size_t depth() {
+      std::lock_guard<std::mutex> lock(mtx);
+      return pending.size() + inflight;
+    }
+
+  private:
+    shared_ptr<typename SocketType::Connection> connection;
+    outbox_stats& stats;
+    stream_pool<typename SocketType::SendStream>& pool;
+    std::size_t highWaterMark;
+    slow_consumer_policy policy;
+
+    std::mutex mtx;
+    // Held from taking frames off pending until they are handed to the connection, so send() calls follow queue order.
+    std::mutex sendMtx;
+    std::deque<frame> pending;
+    std::size_t inflight = 0;
+    bool closed = false;
+    // Fragmented message being written.
+    frame current;
+    bool fragmenting = false;
+
+    void push(frame f) {
+      bool close = false;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (closed) return;
+
+        if (pending.size() >= highWaterMark) {
+          switch (policy) {
+          case slow_consumer_policy::drop:
+            ++stats.dropped;
+            return;
+          case slow_consumer_policy::conflate:
+            if (conflate(f)) return;
+            pending.pop_front();
+            ++stats.dropped;
+            break;
+          case slow_consumer_policy::disconnect:
+            closed = true;
+            close = true;
+            pending.clear();
+            ++stats.disconnected;
+            break;
+          }
+        }
+
+        if (!close) {
+          pending.push_back(std::move(f));
+          ++stats.queued;
+          auto d = pending.size() + inflight;
+          auto m = stats.maxDepth.load();
+          while (d > m && !stats.maxDepth.compare_exchange_weak(m, d)) {}
+        }
+      }
+
+      if (close) {
+        // Under sendMtx, so frames already taken off pending are handed over before the Close frame.
+        std::lock_guard<std::mutex> sending(sendMtx);
+        // 1008: policy violation.
+        connection->send_close(1008, "slow consumer");
+        return;
+      }
+      flush();
+    }
+
+    // Caller holds mtx.
+    bool conflate(frame& next) {
+      if (next.key.empty()) return false;
+      for (auto& f : pending) {
+        if (f.key == next.key) {
+          f.stream = next.stream;
+          f.fin_rsv_opcode = next.fin_rsv_opcode;
+          ++stats.conflated;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void flush() {
+      std::unique_lock<std::mutex> sending(sendMtx);
+      std::vector<frame> ready;
+      bool fragments = false;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (closed || fragmenting) return;
+
+        if (!pending.empty() && pending.front().generator) {
+          // Fragments must not interleave with other frames: wait for the connection to drain.
+          if (inflight > 0) return;
+          current = std::move(pending.front());
+          pending.pop_front();
+          fragmenting = true;
+          inflight = 1;
+          fragments = true;
+        } else {
+          while (!pending.empty() && !pending.front().generator && inflight < highWaterMark) {
+            ready.push_back(std::move(pending.front()));
+            pending.pop_front();
+            ++inflight;
+          }
+        }
+      }
+
+      if (fragments) {
+        // Other flushes stop at `fragmenting`; the generator runs without sendMtx.
+        sending.unlock();
+        sendFragment(true);
+        return;
+      }
+
+      // SimpleWeb writes a connection's frames in the order send() is called; send() only queues the write, so it is safe under sendMtx.
+      auto self = this->shared_from_this();
+      for (auto& f : ready) {
+        connection->send(f.stream, [self](const SimpleWeb::error_code& ec) {
+          self->onSent(ec);
+        }, f.fin_rsv_opcode);
+      }
+    }
+
+    void sendFragment(bool first) {
+      auto stream = pool.lease(current.chunkSize);
+      bool more = current.generator(*stream);
+      // Opcode on the first fragment only, continuation (0) after that, FIN on the last.
+      unsigned char fin_rsv_opcode = (first ? (current.fin_rsv_opcode & 0x0f) : 0) | (more ? 0 : 0x80);
+
+      bool stop;
+      {
+        std::lock_guard<std::mutex> sending(sendMtx);
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          stop = closed;
+        }
+        if (!stop) {
+          auto self = this->shared_from_this();
+          connection->send(stream, [self, more](const SimpleWeb::error_code& ec) {
+            if (!ec && more) {
+              self->sendFragment(false);
+              return;
+            }
+            self->endFragments(ec);
+          }, fin_rsv_opcode);
+        }
+      }
+      // The slow consumer policy already sent Close, and no data frame may follow it.
+      if (stop) endFragments(SimpleWeb::asio::error::operation_aborted);
+    }
+
+    void endFragments(const SimpleWeb::error_code& ec) {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        current = frame{};
+        fragmenting = false;
+      }
+      onSent(ec);
+    }
+
+    void onSent(const SimpleWeb::error_code& ec) {
+      bool next = false;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (ec) {
+          closed = true;
+          pending.clear();
+        } else {
+          ++stats.sent;
+        }
+        --inflight;
+        next = !closed && !pending.empty();
+      }
+      if (next) flush();
+    }
+  };
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef RXWEB_MAX_ROUTE_PARAMS
+#define RXWEB_MAX_ROUTE_PARAMS 8
+#endif
+
+namespace rxweb {
+
+  // A matched :param or *wildcard. Points into the router and the request path, nothing is copied.
+  struct route_param {
+    const std::string* name = nullptr;
+    const char* first = nullptr;
+    std::size_t size = 0;
+
+    std::string value() const { return first ? std::string(first, size) : std::string(); }
+  };
+
+  struct route_params {
+    std::array<route_param, RXWEB_MAX_ROUTE_PARAMS> items;
+    std::size_t count = 0;
+
+    bool push(const std::string& name, const char* first, std::size_t size) {
+      if (count == items.size()) return false;
+      items[count++] = route_param{ &name, first, size };
+      return true;
+    }
+
+    // Returns an empty param (first == nullptr) if the name was not captured.
+    route_param find(const std::string& name) const {
+      for (std::size_t i = 0; i < count; ++i) {
+        if (*(items[i].name) == name) return items[i];
+      }
+      return route_param{};
+    }
+
+    std::string operator[](const std::string& name) const { return find(name).value(); }
+
+    std::size_t size() const { return count; }
+  };
+
+  // Radix tree over path segments.
+  // "/users/:id/files/*rest" registers a static "users" edge, a parameter edge named "id",
+  // a static "files" edge and a trailing wildcard named "rest".
+  // Lookup prefers static edges, then parameters, then wildcards, and backtracks on a miss.
+  // Matching does not allocate.
+  template<typename Handler>
+  class radix_router {
+  public:
+    void add(const std::string& path, Handler handler) {
+      node* n = &root;
+      std::size_t nparams = 0;
+      std::size_t pos = 0;
+
+      while (true) {
+        pos = path.find_first_not_of('/', pos);
+        if (pos == std::string::npos) break;
+        auto next = path.find('/', pos);
+        auto seg = path.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+        pos = next;
+
+        if (seg[0] == ':' || seg[0] == '*') {
+          if (++nparams > RXWEB_MAX_ROUTE_PARAMS) {
+            throw std::invalid_argument("Too many parameters in route " + path);
+          }
+          auto name = seg.substr(1);
+          bool wildcard = seg[0] == '*';
+          auto& child = wildcard ? n->wildcard : n->param;
+
+          if (wildcard && pos != std::string::npos && path.find_first_not_of('/', pos) != std::string::npos) {
+            throw std::invalid_argument("Wildcard must be the last segment in route " + path);
+          }
+          if (!child) {
+            child.reset(new node());
+            child->label = name;
+          } else if (child->label != name) {
+            throw std::invalid_argument("Conflicting parameter name " + seg + " in route " + path);
+          }
+          n = child.get();
+        } else {
+          auto it = lowerBound(n->children, seg.data(), seg.size());
+          if (it == n->children.end() || (*it)->label != seg) {
+            std::unique_ptr<node> child(new node());
+            child->label = seg;
+            it = n->children.insert(it, std::move(child));
+          }
+          n = it->get();
+        }
+
+        if (pos == std::string::npos) break;
+      }
+
+      if (n->terminal) {
+        throw std::invalid_argument("Duplicate route " + path);
+      }
+      n->terminal = true;
+      n->handler = std::move(handler);
+    }
+
+    const Handler* match(const std::string& path, route_params& params) const {
+      params.count = 0;
+      return match(root, path.data(), path.data() + path.size(), params);
+    }
+
+    bool empty() const {
+      return !root.terminal && root.children.empty() && !root.param && !root.wildcard;
+    }
+
+  private:
+    struct node {
+      // Static segment, or the parameter name for :param and *wildcard nodes.
+      std::string label;
+      // Sorted by label.
+      std::vector<std::unique_ptr<node>> children;
+      std::unique_ptr<node> param;
+      std::unique_ptr<node> wildcard;
+      bool terminal = false;
+      Handler handler;
+    };
+
+    node root;
+
+    using Children = std::vector<std::unique_ptr<node>>;
+
+    static typename Children::const_iterator lowerBound(const Children& children, const char* first, std::size_t size) {
+      return std::lower_bound(children.begin(), children.end(), 0, [first, size](const std::unique_ptr<node>& c, int) {
+        return c->label.compare(0, c->label.size(), first, size) < 0;
+      });
+    }
+
+    static typename Children::iterator lowerBound(Children& children, const char* first, std::size_t size) {
+      return std::lower_bound(children.begin(), children.end(), 0, [first, size](const std::unique_ptr<node>& c, int) {
+        return c->label.compare(0, c->label.size(), first, size) < 0;
+      });
+    }
+
+    static const Handler* match(const node& n, const char* p, const char* end, route_params& params) {
+      while (p != end && *p == '/') ++p;
+
+      if (p == end) {
+        if (n.terminal) return &n.handler;
+        if (n.wildcard && params.push(n.wildcard->label, p, 0)) return &n.wildcard->handler;
+        return nullptr;
+      }
+
+      const char* segEnd = std::find(p, end, '/');
+      std::size_t size = segEnd - p;
+
+      auto it = lowerBound(n.children, p, size);
+      if (it != n.children.end() && (*it)->label.compare(0, (*it)->label.size(), p, size) == 0) {
+        if (auto h = match(**it, segEnd, end, params)) return h;
+      }
+
+      auto mark = params.count;
+      if (n.param && params.push(n.param->label, p, size)) {
+        if (auto h = match(*n.param, segEnd, end, params)) return h;
+      }
+      params.count = mark;
+
+      if (n.wildcard && params.push(n.wildcard->label, p, end - p)) {
+        return &n.wildcard->handler;
+      }
+
+      return nullptr;
+    }
+  };
+}
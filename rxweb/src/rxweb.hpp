@@ -9,6 +9,10 @@
 #include "server_http.hpp"
 #include "server_https.hpp"
 #include "server_ws.hpp"
+#include "rxweb/src/router.hpp"
+#include "rxweb/src/singleflight.hpp"
+#include "rxweb/src/lanes.hpp"
+#include "rxweb/src/capture.hpp"
 
 decltype(auto) RxEventLoop = rxcpp::observe_on_event_loop();
 decltype(auto) RxNewThread = rxcpp::observe_on_new_thread();
@@ -44,6 +48,9 @@ namespace rxweb {
       this->request = t1.request;
       this->response = t1.response;
       this->type = t1.type;
+      this->params = t1.params;
+      this->flight = t1.flight;
+      this->priority = t1.priority;
       this->ss = make_shared<stringstream>();
       *(this->ss) << t1.ss->rdbuf();
       json j = json::parse(t1.data->dump());
@@ -54,6 +61,9 @@ namespace rxweb {
       this->request = t1.request;
       this->response = t1.response;
       this->type = t1.type;
+      this->params = t1.params;
+      this->flight = t1.flight;
+      this->priority = t1.priority;
       this->ss = make_shared<stringstream>();
       *(this->ss) << t1.ss->rdbuf();
       json j = json::parse(t1.data->dump());
@@ -61,11 +71,20 @@ namespace rxweb {
       return *this;
     }
 
+    // Moves hand over the buffers instead of deep-copying them, e.g. when lanes dequeue a task.
+    task(task&&) = default;
+    task& operator = (task&&) = default;
+
     shared_ptr<typename SocketType::Request> request;
     shared_ptr<typename SocketType::Response> response;
     shared_ptr<std::stringstream> ss;
     string type;
     shared_ptr<json> data;
+    // Captured :param and *wildcard segments when the request came through the radix router.
+    route_params params;
+    // Set when this task leads coalesced requests; see server::respond().
+    shared_ptr<flight_call> flight;
+    priority_class priority = priority_class::normal;
   };
 
   template<typename T>
@@ -90,6 +109,7 @@ namespace rxweb {
       this->message = t1.message;
       this->type = t1.type;
       this->path = t1.path;
+      this->priority = t1.priority;
       this->ss = make_shared<stringstream>();
       *(this->ss) << t1.ss->rdbuf();
       json j = json::parse(t1.data->dump());
@@ -97,10 +117,11 @@ namespace rxweb {
     }
 
     wstask& operator = (const wstask& t1) {
-      this->connection = t1.conection;
+      this->connection = t1.connection;
       this->message = t1.message;
       this->type = t1.type;
       this->path = t1.path;
+      this->priority = t1.priority;
       this->ss = make_shared<stringstream>();
       *(this->ss) << t1.ss->rdbuf();
       json j = json::parse(t1.data->dump());
@@ -108,12 +129,36 @@ namespace rxweb {
       return *this;
     }
 
+    wstask(wstask&&) = default;
+    wstask& operator = (wstask&&) = default;
+
+    // The message body as chunks of at most chunkSize bytes, read from the message buffer instead of
+    // copying it whole with message->string(). Consumes the message. SimpleWeb has already buffered
+    // the whole message by the time a route sees it, so this does not bound inbound memory; it only
+    // avoids extra whole-message copies when the subscriber handles each chunk as it arrives.
+    rxcpp::observable<string> chunks(std::size_t chunkSize = 64 * 1024) const {
+      auto msg = message;
+      return rxcpp::observable<>::create<string>([msg, chunkSize](rxcpp::subscriber<string> s) {
+        if (msg) {
+          string buffer(chunkSize, '\0');
+          while (s.is_subscribed()) {
+            msg->read(&buffer[0], chunkSize);
+            auto n = msg->gcount();
+            if (n <= 0) break;
+            s.on_next(buffer.substr(0, static_cast<std::size_t>(n)));
+          }
+        }
+        s.on_completed();
+      }).as_dynamic();
+    }
+
     shared_ptr<typename SimpleWeb::SocketServerBase<T>::Connection> connection;
     shared_ptr<typename SimpleWeb::SocketServerBase<T>::Message> message;
     string path;
     shared_ptr<std::stringstream> ss;
     string type;
     shared_ptr<json> data;    
+    priority_class priority = priority_class::normal;
   };
   
   template<typename T>
@@ -125,6 +170,8 @@ namespace rxweb {
   
     FilterFunc filterFunc;
     SubscribeFunc subscribeFunc;
+    // Tasks matching this middleware's filter on arrival are queued in this lane.
+    priority_class priority = priority_class::normal;
 
     middleware() = default;
 
@@ -132,6 +179,12 @@ namespace rxweb {
       FilterFunc _filterFunc,
       SubscribeFunc _subscribeFunc
     ) : filterFunc(_filterFunc), subscribeFunc(_subscribeFunc) {}
+
+    middleware(
+      FilterFunc _filterFunc,
+      SubscribeFunc _subscribeFunc,
+      priority_class _priority
+    ) : filterFunc(_filterFunc), subscribeFunc(_subscribeFunc), priority(_priority) {}
     
     middleware(FilterFunc _filterFunc) : filterFunc(_filterFunc) {}
   };
@@ -145,6 +198,8 @@ namespace rxweb {
 
     FilterFunc filterFunc;
     SubscribeFunc subscribeFunc;
+    // Tasks matching this middleware's filter on arrival are queued in this lane.
+    priority_class priority = priority_class::normal;
 
     wsmiddleware() = default;
 
@@ -154,9 +209,27 @@ namespace rxweb {
     ) : filterFunc(_filterFunc), subscribeFunc(_subscribeFunc) {
     }
 
+    wsmiddleware(
+      FilterFunc _filterFunc,
+      SubscribeFunc _subscribeFunc,
+      priority_class _priority
+    ) : filterFunc(_filterFunc), subscribeFunc(_subscribeFunc), priority(_priority) {
+    }
+
     wsmiddleware(FilterFunc _filterFunc) : filterFunc(_filterFunc) {}
   };
   
+  // Read a request body or WebSocket message and put it back for the next reader.
+  template<typename Content>
+  string peekContent(Content& content) {
+    stringstream ss;
+    ss << content.rdbuf();
+    auto body = ss.str();
+    content.clear();
+    content.rdbuf()->sputn(body.data(), body.size());
+    return body;
+  }
+
   // Default Exception Handler Handler
   void handleEptr(std::exception_ptr eptr) {
     try {
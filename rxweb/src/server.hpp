@@ -3,12 +3,16 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <map>
+#include <set>
 #include <rxcpp/rx.hpp>
 #include "server_http.hpp"
 #include "rxweb/src/rxweb.hpp"
 #include "rxweb/src/subject.hpp"
 #include "rxweb/src/observer.hpp"
 #include "rxweb/src/subscriber.hpp"
+#include "rxweb/src/static_files.hpp"
+#include "rxweb/src/unix_socket.hpp"
 
 namespace rxweb {
   template<typename T>
@@ -21,6 +25,22 @@ namespace rxweb {
     Route(string expression_, string verb_, WebAction action_) : expression(expression_), verb(verb_), action(action_) {}
   };
 
+  // Route served by the radix router, e.g. "/users/:id" or "/static/*path".
+  template<typename T>
+  struct PathRoute {
+    using TaskAction = std::function<void(rxweb::task<T>&)>;
+    string path;
+    string verb;
+    TaskAction action;
+    // Collapse identical in-flight requests on this route into one task.
+    bool coalesce = false;
+    // Lane for tasks entering through this route.
+    priority_class priority = priority_class::normal;
+    PathRoute() = default;
+    PathRoute(string path_, string verb_, TaskAction action_, bool coalesce_ = false, priority_class priority_ = priority_class::normal)
+      : path(path_), verb(verb_), action(action_), coalesce(coalesce_), priority(priority_) {}
+  };
+
   template<typename T>
   class server {
     using SocketType = SimpleWeb::ServerBase<T>;
@@ -28,7 +48,7 @@ namespace rxweb {
     using RxWebObserver = rxweb::observer<T>;
     using RxWebSubscriber = rxweb::subscriber<T>;
     using RxWebMiddleware = rxweb::middleware<T>;
-    using WebServer = SimpleWeb::Server<T>;
+    using WebServer = typename http_listener<T>::type;
 
   public:
     // User provides custom Middleware.
@@ -39,6 +59,52 @@ namespace rxweb {
     
     // User Defined Routes.
     vector<Route<T>> routes;
+
+    // User Defined radix tree routes. When present they are matched first and `routes` become the regex fallback.
+    vector<PathRoute<T>> paths;
+
+    // Collapse identical in-flight POSTs on the default endpoint. Routes opt in with PathRoute::coalesce.
+    bool coalesce = false;
+
+    // Identifies identical requests. Defaults to method, path, query string, the credential headers and the whole body,
+    // so requests from different users or with different bodies never share a response.
+    std::function<string(shared_ptr<typename SocketType::Request>, const string&)> coalesceKey = [](shared_ptr<typename SocketType::Request> request, const string& body) {
+      auto key = request->method + " " + request->path + "?" + request->query_string + "\n";
+      for (auto name : { "Authorization", "Proxy-Authorization", "Cookie" }) {
+        auto range = request->header.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it) {
+          key += std::to_string(it->second.size()) + ":" + it->second;
+        }
+        key += "\n";
+      }
+      return key + body;
+    };
+
+    // In-flight table and counters for coalesced requests.
+    rxweb::singleflight flights;
+
+    // Serve GET requests from a directory, e.g. make_shared<rxweb::static_files<T>>("/var/www", "/static/").
+    // Missing files under the prefix get a 404; GETs outside it still get the empty 200.
+    shared_ptr<static_files<T>> files;
+
+    // Also listen on this Unix domain socket path (plain HTTP only). Set tcpListener to false to skip config.port.
+    string unixSocket;
+    bool tcpListener = true;
+
+    // Optional traffic capture of every request entering the server. Set before start().
+    shared_ptr<capture_writer> recorder;
+
+    // Worker threads serving the priority lanes. 0 dispatches straight to the subject on the event loop.
+    std::size_t laneWorkers = 0;
+
+    // Lane policy, weights and per-lane queue-wait stats.
+    rxweb::lanes<RxWebTask> lanes;
+
+    // Takes over dispatch when set, e.g. by a unified_server that owns the subject.
+    std::function<void(const RxWebTask&)> dispatcher;
+
+    // Handed requests carrying an Upgrade header, e.g. to upgrade WebSockets on this port.
+    std::function<void(std::unique_ptr<T>&, shared_ptr<typename SocketType::Request>)> onUpgrade;
     
     explicit server(int _port, int _threads = 1) : port(_port), threads(_threads) {
       _server = make_shared<WebServer>();
@@ -61,6 +127,11 @@ namespace rxweb {
       _server->config.port = port;
       _server->config.thread_pool_size = threads;
     }
+
+    // Lane workers call into the subject, which is declared after them and would otherwise be destroyed first.
+    ~server() {
+      lanes.stop();
+    }
     
     void applyRoutes() {
       std::for_each(routes.begin(), routes.end(), [&, this](const Route<T>& r) {
@@ -68,19 +139,78 @@ namespace rxweb {
       });
     }
 
+    void applyPaths() {
+      for (auto& p : paths) {
+        routers[p.verb].add(p.path, p);
+      }
+      for (auto& r : routes) {
+        fallbackRoutes.emplace_back(SimpleWeb::regex::regex(r.expression), r);
+      }
+
+      set<string> verbs{ "POST", "GET" };
+      for (auto& p : paths) verbs.insert(p.verb);
+      for (auto& r : routes) verbs.insert(r.verb);
+
+      // Every verb enters through the radix tree, then the regex routes, then the default resource.
+      for (auto& verb : verbs) {
+        auto fallback = _server->default_resource[verb];
+        _server->default_resource[verb] = [this, fallback](shared_ptr<typename SocketType::Response> response, shared_ptr<typename SocketType::Request> request) {
+          if (routePath(response, request) || routeRegex(response, request)) return;
+          if (fallback) {
+            fallback(response, request);
+          } else {
+            *response << "HTTP/1.1 404 Not Found\r\nContent-Length: " << 0 << "\r\n\r\n";
+          }
+        };
+      }
+    }
+
     rxweb::subject<T> getSubject() {
       return sub;
     }
 
+    // Inbound tasks are classified here, so route actions should dispatch rather than call the subject directly.
     void dispatch(const RxWebTask& t) {
-      sub.subscriber().on_next(t);
+      if (dispatcher) {
+        dispatcher(t);
+      } else if (lanes.running()) {
+        lanes.push(classify(t), t);
+      } else {
+        sub.subscriber().on_next(t);
+      }
     } 
 
+    // Highest priority among the task's own class and the middlewares that would accept it.
+    priority_class classify(const RxWebTask& t) {
+      auto p = t.priority;
+      for (auto& m : middlewares) {
+        if (m.priority != priority_class::normal && higher(m.priority, p) != p && m.filterFunc(t)) p = m.priority;
+      }
+      if (onNext.filterFunc && onNext.priority != priority_class::normal && higher(onNext.priority, p) != p && onNext.filterFunc(t)) p = onNext.priority;
+      return p;
+    }
+
+    // Write a complete HTTP response and hand the same bytes to any requests coalesced onto this task.
+    void respond(const RxWebTask& t, const string& bytes) {
+      *(t.response) << bytes;
+      if (t.flight) flights.complete(t.flight, bytes);
+    }
+
     void start() {
       
       // Depending on the observer's filter function, each observer will act or ignore any incoming web request.
       makeObserversAndSubscribeFromMiddlewares();
 
+      if (laneWorkers > 0) {
+        lanes.start(laneWorkers, [this](RxWebTask& t) {
+          try {
+            sub.subscriber().on_next(t);
+          } catch (...) {
+            rxweb::handleEptr(std::current_exception());
+          }
+        });
+      }
+
       // Wait for all observers to finish.
       auto subscriber = rxcpp::make_subscriber<RxWebTask>(
         [](RxWebTask& t) { }, //noop,
@@ -90,26 +220,105 @@ namespace rxweb {
       // Defaults: 1 endpoint for POST/GET
       _server->default_resource["POST"] = [this](std::shared_ptr<typename SocketType::Response> response, std::shared_ptr<typename SocketType::Request> request) {
         auto t = RxWebTask{ request, response };
-        sub.subscriber().on_next(t);
+        if (coalesce && !lead(t)) return;
+        dispatch(t);
       };
 
-      _server->default_resource["GET"] = [](shared_ptr<typename SocketType::Response> response, shared_ptr<typename SocketType::Request> request) {
+      _server->default_resource["GET"] = [this](shared_ptr<typename SocketType::Response> response, shared_ptr<typename SocketType::Request> request) {
+        if (files && files->serve(response, request)) return;
         *response << "HTTP/1.1 200 OK\r\nContent-Length: " << 0 << "\r\n\r\n";
       };
 
       // Apply user-defined routes
-      applyRoutes();
+      if (paths.empty()) {
+        applyRoutes();
+      } else {
+        applyPaths();
+      }
+
+      if (recorder) applyCapture();
+
+      if (onUpgrade) _server->on_upgrade = onUpgrade;
+
+      http_listener<T>::listen(*_server, unixSocket, tcpListener || unixSocket.empty());
 
       _server->start();
     }
+    void stop() {
+      _server->stop();
+      lanes.stop();
+    }
+
   private:
     int port, threads;
     std::string certFile, privateKeyFile, socketType;
     shared_ptr<WebServer> _server;
     rxweb::subject<T> sub;
+    map<string, radix_router<PathRoute<T>>> routers;
+    vector<pair<SimpleWeb::regex::regex, Route<T>>> fallbackRoutes;
     
     std::function<void(std::exception_ptr&)> defaultOnErrorFunc = [](const std::exception_ptr& e) { rxweb::handleEptr(e); };
 
+    // Record the request before any handler sees it.
+    void applyCapture() {
+      auto wrap = [this](std::function<void(shared_ptr<typename SocketType::Response>, shared_ptr<typename SocketType::Request>)>& handler) {
+        auto inner = handler;
+        handler = [this, inner](shared_ptr<typename SocketType::Response> response, shared_ptr<typename SocketType::Request> request) {
+          auto path = request->query_string.empty() ? request->path : request->path + "?" + request->query_string;
+          recorder->record(capture_kind::http, 0, request->method, path, peekContent(request->content));
+          inner(response, request);
+        };
+      };
+      for (auto& r : _server->resource) {
+        for (auto& v : r.second) wrap(v.second);
+      }
+      for (auto& v : _server->default_resource) wrap(v.second);
+    }
+
+    bool routePath(shared_ptr<typename SocketType::Response> response, shared_ptr<typename SocketType::Request> request) {
+      auto it = routers.find(request->method);
+      if (it == routers.end()) return false;
+
+      route_params params;
+      auto route = it->second.match(request->path, params);
+      if (!route) return false;
+
+      auto t = RxWebTask{ request, response };
+      t.params = params;
+      t.priority = route->priority;
+      if (route->coalesce && !lead(t)) return true;
+      route->action(t);
+      return true;
+    }
+
+    // Returns false if the request was attached to an identical in-flight request and must not run.
+    bool lead(RxWebTask& t) {
+      auto body = peekContent(t.request->content);
+      auto response = t.response;
+      t.flight = flights.join(coalesceKey(t.request, body), [response](const string& bytes) {
+        *response << bytes;
+      });
+      return t.flight != nullptr;
+    }
+
+    bool routeRegex(shared_ptr<typename SocketType::Response> response, shared_ptr<typename SocketType::Request> request) {
+      for (auto& r : fallbackRoutes) {
+        if (r.second.verb == request->method && SimpleWeb::regex::regex_match(request->path, request->path_match, r.first)) {
+          r.second.action(response, request);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Lane workers already run off the io threads, so observers stay on the worker that dequeued the task.
+    RxWebObserver makeObserver(typename RxWebMiddleware::FilterFunc filterFunc) {
+      if (laneWorkers > 0) {
+        return RxWebObserver(sub.observable(), filterFunc, rxcpp::identity_current_thread());
+      }
+      return RxWebObserver(sub.observable(), filterFunc);
+    }
+
     /*
       Using makeObserversAndSubscribeFromMiddlewares() will not wait for all middlewares to complete.
     */
@@ -117,11 +326,13 @@ namespace rxweb {
       // No subscription, observers does nothing.      
       // Create Observers that react to subscriber broadcast.
       std::for_each(middlewares.begin(), middlewares.end(), [&](auto& route) {
-        RxWebObserver observer(sub.observable(), route.filterFunc);
+        auto observer = makeObserver(route.filterFunc);
         observer.subscribe(route.subscribeFunc, defaultOnErrorFunc);
       });
       // Last Observer is the one that will respond to client after all middlwares have been processed.
-      RxWebObserver lastObserver(sub.observable(), onNext.filterFunc);
+      // static_server responds from its own pipeline and may leave onNext empty.
+      if (!onNext.filterFunc) return;
+      auto lastObserver = makeObserver(onNext.filterFunc);
       lastObserver.subscribe(onNext.subscribeFunc, defaultOnErrorFunc);
     }
   };
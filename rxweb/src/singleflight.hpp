@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rxweb {
+
+  // One in-flight request and the identical requests waiting on its response.
+  struct flight_call {
+    using Waiter = std::function<void(const std::string&)>;
+
+    std::string key;
+    std::vector<Waiter> waiters;
+    std::function<void()> release;
+    bool done = false;
+
+    ~flight_call() {
+      if (release) release();
+      // Leader went away without responding. Do not leave the followers hanging.
+      if (!done) {
+        for (auto& w : waiters) w("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n");
+      }
+    }
+  };
+
+  /*
+    Coalesces identical requests while one of them is executing.
+    The first caller for a key becomes the leader and gets the call back from join().
+    Later callers are attached as waiters and receive the leader's response bytes from complete().
+    The table only holds weak references; a call lives as long as the leader's task copies.
+  */
+  class singleflight {
+  public:
+    // Requests that ran the pipeline.
+    std::atomic<std::uint64_t> executed{ 0 };
+    // Requests that were answered with another request's response.
+    std::atomic<std::uint64_t> collapsed{ 0 };
+
+    // Returns the call to lead, or nullptr if the waiter was attached to an in-flight call.
+    std::shared_ptr<flight_call> join(const std::string& key, flight_call::Waiter waiter) {
+      // Declared before the lock: if this ends up as the last reference, the call releases itself unlocked.
+      std::shared_ptr<flight_call> existing;
+      std::lock_guard<std::mutex> lock(mtx);
+
+      auto it = calls.find(key);
+      if (it != calls.end() && (existing = it->second.lock())) {
+        existing->waiters.push_back(std::move(waiter));
+        ++collapsed;
+        return nullptr;
+      }
+
+      auto call = std::make_shared<flight_call>();
+      call->key = key;
+      call->release = [this, key]() {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = calls.find(key);
+        if (it != calls.end() && it->second.expired()) calls.erase(it);
+      };
+      calls[key] = call;
+      ++executed;
+      return call;
+    }
+
+    void complete(const std::shared_ptr<flight_call>& call, const std::string& bytes) {
+      std::vector<flight_call::Waiter> waiters;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (call->done) return;
+        call->done = true;
+        waiters.swap(call->waiters);
+        auto it = calls.find(call->key);
+        if (it != calls.end() && it->second.lock() == call) calls.erase(it);
+      }
+
+      for (auto& w : waiters) w(bytes);
+    }
+
+    std::size_t inflight() {
+      std::lock_guard<std::mutex> lock(mtx);
+      return calls.size();
+    }
+
+  private:
+    std::mutex mtx;
+    std::unordered_map<std::string, std::weak_ptr<flight_call>> calls;
+  };
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "server_http.hpp"
+
+namespace rxweb {
+
+  /*
+    Serves GET requests from a directory.
+    Small files are cached in memory with their response headers prebuilt. Larger files are read
+    with pread() straight into the response buffer one chunk at a time, waiting for each chunk to be
+    sent before reading the next, so a large file is never held whole in memory. If a file shrinks
+    while it is being sent, the response is cut short and the connection closed.
+    Supports ETag / If-None-Match and single byte ranges. Paths under the prefix that do not name a
+    file get a 404.
+  */
+  template<typename T>
+  class static_files {
+    using SocketType = SimpleWeb::ServerBase<T>;
+
+    struct open_file {
+      int fd = -1;
+
+      ~open_file() {
+        if (fd >= 0) close(fd);
+      }
+    };
+
+    struct cached {
+      std::string etag;
+      off_t size;
+      time_t mtime;
+      std::string header;
+      std::string notModified;
+      std::string body;
+    };
+
+  public:
+    std::string root;
+    // Mounted under this URL prefix.
+    std::string prefix = "/";
+    std::string index = "index.html";
+    // Files up to this size are kept in memory.
+    std::size_t cacheFileLimit = 64 * 1024;
+    std::size_t cacheBytesLimit = 32 * 1024 * 1024;
+    std::size_t chunkSize = 128 * 1024;
+
+    static_files() = default;
+
+    explicit static_files(const std::string& root_, const std::string& prefix_ = "/") : root(root_), prefix(prefix_) {}
+
+    // Returns false if the request is outside the prefix.
+    bool serve(shared_ptr<typename SocketType::Response> response, shared_ptr<typename SocketType::Request> request) {
+      if (request->path.compare(0, prefix.size(), prefix) != 0) return false;
+
+      std::string file;
+      struct stat st;
+      if (!resolve(request->path, file) || stat(file.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        *response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        return true;
+      }
+
+      auto ifNoneMatch = header(request, "If-None-Match");
+      auto range = header(request, "Range");
+
+      if (static_cast<std::size_t>(st.st_size) <= cacheFileLimit) {
+        auto entry = lookup(file, st);
+        if (entry) {
+          if (matches(ifNoneMatch, entry->etag)) {
+            *response << entry->notModified;
+          } else if (!range.empty()) {
+            serveRange(response, range, entry->etag, file, entry->body.data(), entry->body.size());
+          } else {
+            *response << entry->header << entry->body;
+          }
+          return true;
+        }
+      }
+
+      auto etag = makeEtag(st);
+      if (matches(ifNoneMatch, etag)) {
+        *response << "HTTP/1.1 304 Not Modified\r\nETag: " << etag << "\r\n\r\n";
+        return true;
+      }
+
+      auto f = openFile(file);
+      if (!f) {
+        *response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        return true;
+      }
+      std::size_t size = st.st_size;
+
+      if (!range.empty()) {
+        serveRange(response, range, etag, file, nullptr, size, f);
+      } else {
+        *response << "HTTP/1.1 200 OK\r\nContent-Type: " << contentType(file) << "\r\nContent-Length: " << size
+          << "\r\nETag: " << etag << "\r\nAccept-Ranges: bytes\r\n\r\n";
+        sendChunks(response, f, 0, size);
+      }
+      return true;
+    }
+
+    std::size_t cachedBytes() {
+      std::lock_guard<std::mutex> lock(mtx);
+      return cacheBytes;
+    }
+
+  private:
+    std::mutex mtx;
+    // Most recently used first.
+    std::list<std::pair<std::string, shared_ptr<cached>>> lru;
+    std::unordered_map<std::string, typename std::list<std::pair<std::string, shared_ptr<cached>>>::iterator> cache;
+    std::size_t cacheBytes = 0;
+
+    bool resolve(const std::string& path, std::string& file) {
+      if (path.compare(0, prefix.size(), prefix) != 0) return false;
+
+      std::string rel;
+      for (std::size_t i = prefix.size(); i < path.size(); ++i) {
+        if (path[i] == '%' && i + 2 < path.size() && isxdigit(path[i + 1]) && isxdigit(path[i + 2])) {
+          rel += static_cast<char>(std::stoi(path.substr(i + 1, 2), nullptr, 16));
+          i += 2;
+        } else {
+          rel += path[i];
+        }
+      }
+
+      // No way out of root.
+      if (rel.find('\0') != std::string::npos || rel.find('\\') != std::string::npos) return false;
+      std::size_t pos = 0;
+      while (pos <= rel.size()) {
+        auto next = rel.find('/', pos);
+        if (next == std::string::npos) next = rel.size();
+        if (rel.compare(pos, next - pos, "..") == 0) return false;
+        pos = next + 1;
+      }
+
+      if (rel.empty() || rel.back() == '/') rel += index;
+      file = root + (rel.front() == '/' || (!root.empty() && root.back() == '/') ? "" : "/") + rel;
+      return true;
+    }
+
+    static std::string header(shared_ptr<typename SocketType::Request> request, const std::string& name) {
+      auto it = request->header.find(name);
+      return it == request->header.end() ? std::string() : it->second;
+    }
+
+    static bool matches(const std::string& ifNoneMatch, const std::string& etag) {
+      return !ifNoneMatch.empty() && (ifNoneMatch == "*" || ifNoneMatch.find(etag) != std::string::npos);
+    }
+
+    static std::string makeEtag(const struct stat& st) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "\"%llx-%llx\"", static_cast<unsigned long long>(st.st_size), static_cast<unsigned long long>(st.st_mtime));
+      return buf;
+    }
+
+    static std::string contentType(const std::string& file) {
+      static const std::unordered_map<std::string, std::string> types{
+        { "html", "text/html; charset=utf-8" }, { "htm", "text/html; charset=utf-8" },
+        { "css", "text/css" }, { "js", "application/javascript" }, { "json", "application/json" },
+        { "map", "application/json" }, { "txt", "text/plain; charset=utf-8" }, { "csv", "text/csv" },
+        { "xml", "application/xml" }, { "svg", "image/svg+xml" }, { "png", "image/png" },
+        { "jpg", "image/jpeg" }, { "jpeg", "image/jpeg" }, { "gif", "image/gif" }, { "ico", "image/x-icon" },
+        { "woff", "font/woff" }, { "woff2", "font/woff2" }, { "pdf", "application/pdf" }, { "wasm", "application/wasm" }
+      };
+      auto dot = file.rfind('.');
+      if (dot != std::string::npos) {
+        auto it = types.find(file.substr(dot + 1));
+        if (it != types.end()) return it->second;
+      }
+      return "application/octet-stream";
+    }
+
+    static shared_ptr<open_file> openFile(const std::string& file) {
+      auto f = make_shared<open_file>();
+      f->fd = open(file.c_str(), O_RDONLY);
+      return f->fd < 0 ? nullptr : f;
+    }
+
+    // Reads up to n bytes at offset. Fewer means the file shrank or failed.
+    static std::size_t readAt(int fd, char* out, std::size_t n, std::size_t offset) {
+      std::size_t got = 0;
+      while (got < n) {
+        auto r = pread(fd, out + got, n - got, offset + got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += r;
+      }
+      return got;
+    }
+
+    shared_ptr<cached> lookup(const std::string& file, const struct stat& st) {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = cache.find(file);
+        if (it != cache.end()) {
+          auto entry = it->second->second;
+          if (entry->size == st.st_size && entry->mtime == st.st_mtime) {
+            lru.splice(lru.begin(), lru, it->second);
+            return entry;
+          }
+          cacheBytes -= entry->body.size();
+          lru.erase(it->second);
+          cache.erase(it);
+        }
+      }
+
+      auto f = openFile(file);
+      if (!f) return nullptr;
+
+      auto entry = make_shared<cached>();
+      entry->etag = makeEtag(st);
+      entry->size = st.st_size;
+      entry->mtime = st.st_mtime;
+      entry->body.resize(st.st_size);
+      if (!entry->body.empty()) entry->body.resize(readAt(f->fd, &entry->body[0], entry->body.size(), 0));
+      entry->header = "HTTP/1.1 200 OK\r\nContent-Type: " + contentType(file) + "\r\nContent-Length: " + std::to_string(entry->body.size()) +
+        "\r\nETag: " + entry->etag + "\r\nAccept-Ranges: bytes\r\n\r\n";
+      entry->notModified = "HTTP/1.1 304 Not Modified\r\nETag: " + entry->etag + "\r\n\r\n";
+
+      std::lock_guard<std::mutex> lock(mtx);
+      if (cache.find(file) == cache.end()) {
+        lru.emplace_front(file, entry);
+        cache[file] = lru.begin();
+        cacheBytes += entry->body.size();
+        while (cacheBytes > cacheBytesLimit && !lru.empty()) {
+          cacheBytes -= lru.back().second->body.size();
+          cache.erase(lru.back().first);
+          lru.pop_back();
+        }
+      }
+      return entry;
+    }
+
+    // Single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range. Anything else gets the whole file.
+    static bool parseRange(const std::string& range, std::size_t size, std::size_t& first, std::size_t& last, bool& satisfiable) {
+      satisfiable = true;
+      if (range.compare(0, 6, "bytes=") != 0 || range.find(',') != std::string::npos) return false;
+      auto dash = range.find('-', 6);
+      if (dash == std::string::npos) return false;
+
+      auto a = range.substr(6, dash - 6);
+      auto b = range.substr(dash + 1);
+      try {
+        if (a.empty()) {
+          if (b.empty()) return false;
+          auto suffix = std::stoull(b);
+          if (suffix == 0 || size == 0) {
+            satisfiable = false;
+            return true;
+          }
+          first = suffix >= size ? 0 : size - suffix;
+          last = size - 1;
+        } else {
+          first = std::stoull(a);
+          last = b.empty() ? size - 1 : std::min<std::size_t>(std::stoull(b), size - 1);
+          if (first >= size || first > last) {
+            satisfiable = false;
+            return true;
+          }
+        }
+      } catch (...) {
+        return false;
+      }
+      return true;
+    }
+
+    void serveRange(
+      shared_ptr<typename SocketType::Response> response,
+      const std::string& range,
+      const std::string& etag,
+      const std::string& file,
+      const char* data,
+      std::size_t size,
+      shared_ptr<open_file> f = nullptr
+    ) {
+      std::size_t first = 0, last = 0;
+      bool satisfiable;
+      if (!parseRange(range, size, first, last, satisfiable)) {
+        first = 0;
+        last = size - 1;
+        if (size == 0) {
+          *response << "HTTP/1.1 200 OK\r\nContent-Type: " << contentType(file) << "\r\nContent-Length: 0\r\nETag: " << etag << "\r\n\r\n";
+          return;
+        }
+        *response << "HTTP/1.1 200 OK\r\n";
+      } else if (!satisfiable) {
+        *response << "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" << size << "\r\nContent-Length: 0\r\n\r\n";
+        return;
+      } else {
+        *response << "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " << first << "-" << last << "/" << size << "\r\n";
+      }
+
+      *response << "Content-Type: " << contentType(file) << "\r\nContent-Length: " << (last - first + 1)
+        << "\r\nETag: " << etag << "\r\nAccept-Ranges: bytes\r\n\r\n";
+
+      if (f) {
+        sendChunks(response, f, first, last + 1);
+      } else {
+        response->write(data + first, last - first + 1);
+      }
+    }
+
+    // pread() each chunk straight into the response's buffer; SimpleWeb's Response is an ostream over an asio::streambuf.
+    void sendChunks(shared_ptr<typename SocketType::Response> response, shared_ptr<open_file> f, std::size_t offset, std::size_t end) {
+      auto n = std::min(chunkSize, end - offset);
+      if (n == 0) return;
+
+      std::size_t got = 0;
+      if (auto buffer = dynamic_cast<SimpleWeb::asio::streambuf*>(response->rdbuf())) {
+        auto space = buffer->prepare(n);
+        got = readAt(f->fd, SimpleWeb::asio::buffer_cast<char*>(space), n, offset);
+        buffer->commit(got);
+      }
+      if (got < n) {
+        // Content-Length can no longer be met.
+        response->close_connection_after_response = true;
+        return;
+      }
+
+      if (offset + n < end) {
+        response->send([this, response, f, offset, n, end](const SimpleWeb::error_code& ec) {
+          if (!ec) sendChunks(response, f, offset + n, end);
+        });
+      }
+    }
+  };
+}
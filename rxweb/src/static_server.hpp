@@ -0,0 +1,67 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+#include <rxcpp/rx.hpp>
+#include "rxweb/src/rxweb.hpp"
+#include "rxweb/src/server.hpp"
+
+namespace rxweb {
+
+  /*
+    Middlewares known at compile time.
+    Each Mw is a default constructible type providing:
+
+      bool filter(const rxweb::task<T>& t) const;
+
+      template<typename Server>
+      void operator()(Server& server, const rxweb::task<T>& t) const;
+
+    Filters and actions are called directly, so the compiler can inline the whole chain
+    instead of going through std::function and one rxcpp observer per middleware.
+    Middlewares are tried in declaration order; put the responder last.
+  */
+  template<typename T, typename... Mw>
+  class static_server : public server<T> {
+    using RxWebTask = rxweb::task<T>;
+
+  public:
+    using server<T>::server;
+
+    // Instances of the compile-time middlewares, in case they carry state.
+    std::tuple<Mw...> pipeline;
+
+    // Run the task through the compile-time middlewares on the calling thread.
+    void dispatchStatic(const RxWebTask& t) {
+      dispatchStatic(t, std::index_sequence_for<Mw...>{});
+    }
+
+    void start() {
+      // One observer for the whole pipeline. Dynamic middlewares, if any, are still wired by server<T>::start().
+      // With priority lanes the lane worker runs the pipeline itself.
+      rxcpp::observable<RxWebTask> o = this->getSubject().observable();
+      if (this->laneWorkers == 0) {
+        o = o.observe_on(RxEventLoop);
+      }
+      o.subscribe(
+        [this](const RxWebTask& t) {
+          try {
+            dispatchStatic(t);
+          } catch (...) {
+            rxweb::handleEptr(std::current_exception());
+          }
+        },
+        [](const std::exception_ptr& e) { rxweb::handleEptr(e); }
+      );
+
+      server<T>::start();
+    }
+
+  private:
+    template<std::size_t... I>
+    void dispatchStatic(const RxWebTask& t, std::index_sequence<I...>) {
+      using expand = int[];
+      (void)expand{ 0, (std::get<I>(pipeline).filter(t) ? (std::get<I>(pipeline)(*this, t), 0) : 0)... };
+    }
+  };
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "server_ws.hpp"
+
+namespace rxweb {
+
+  struct pool_stats {
+    std::atomic<std::uint64_t> leases{ 0 };
+    // Leases served from a free list.
+    std::atomic<std::uint64_t> hits{ 0 };
+    std::atomic<std::uint64_t> returns{ 0 };
+    // Streams deleted on return because the free list was full or they outgrew the largest size class.
+    std::atomic<std::uint64_t> discarded{ 0 };
+  };
+
+  /*
+    Reusable send streams, e.g. SimpleWeb's SendStream.
+    A leased stream comes back when its last reference drops, which for a send is right after the write
+    completion handler. SimpleWeb writes the streambuf without consuming it (so one stream can be
+    broadcast), so the pool empties it on return. The streambuf keeps its capacity, so the next message
+    of a similar size does not allocate; the stream goes back to the larger of the class it was leased
+    from and the class of what was written into it. Streams that grew past the last class are deleted.
+    Stream must be a default constructible std::ostream over a SimpleWeb::asio::streambuf, e.g. SendStream.
+  */
+  template<typename Stream>
+  class stream_pool {
+    static const std::size_t classes = 4;
+
+    struct state {
+      std::array<std::mutex, classes> mutexes;
+      std::array<std::vector<Stream*>, classes> free;
+      std::size_t maxFree;
+      pool_stats stats;
+
+      ~state() {
+        for (auto& f : free) {
+          for (auto s : f) delete s;
+        }
+      }
+    };
+
+  public:
+    // Upper bound of each size class in bytes. Larger leases use the last class and are not pooled on return.
+    static constexpr std::size_t classSize(std::size_t c) {
+      return c == 0 ? 256 : c == 1 ? 4096 : c == 2 ? 65536 : 1048576;
+    }
+
+    explicit stream_pool(std::size_t maxFreePerClass = 256) : s(std::make_shared<state>()) {
+      s->maxFree = maxFreePerClass;
+    }
+
+    std::shared_ptr<Stream> lease(std::size_t sizeHint = 0) {
+      auto c = sizeClass(sizeHint);
+      ++s->stats.leases;
+
+      Stream* stream = nullptr;
+      {
+        std::lock_guard<std::mutex> lock(s->mutexes[c]);
+        auto& f = s->free[c];
+        if (!f.empty()) {
+          stream = f.back();
+          f.pop_back();
+        }
+      }
+      if (stream) {
+        ++s->stats.hits;
+      } else {
+        stream = new Stream();
+      }
+
+      std::weak_ptr<state> owner = s;
+      return std::shared_ptr<Stream>(stream, [owner, c](Stream* stream) {
+        auto s = owner.lock();
+        auto buffer = dynamic_cast<SimpleWeb::asio::streambuf*>(stream->rdbuf());
+        auto used = buffer ? buffer->size() : 0;
+        if (!s || !buffer || used > classSize(classes - 1)) {
+          if (s) ++s->stats.discarded;
+          delete stream;
+          return;
+        }
+
+        buffer->consume(used);
+        stream->clear();
+        auto slot = std::max(c, sizeClass(used));
+        {
+          std::lock_guard<std::mutex> lock(s->mutexes[slot]);
+          if (s->free[slot].size() < s->maxFree) {
+            s->free[slot].push_back(stream);
+            stream = nullptr;
+          }
+        }
+        if (stream) {
+          ++s->stats.discarded;
+          delete stream;
+        } else {
+          ++s->stats.returns;
+        }
+      });
+    }
+
+    const pool_stats& stats() const {
+      return s->stats;
+    }
+
+    double hitRate() const {
+      auto l = s->stats.leases.load();
+      return l == 0 ? 0.0 : static_cast<double>(s->stats.hits.load()) / l;
+    }
+
+    // Idle streams held by the pool.
+    std::size_t pooled() const {
+      std::size_t n = 0;
+      for (std::size_t c = 0; c < classes; ++c) {
+        std::lock_guard<std::mutex> lock(s->mutexes[c]);
+        n += s->free[c].size();
+      }
+      return n;
+    }
+
+    // Approximate bytes retained by idle streams, counting each at its size class bound.
+    std::size_t footprint() const {
+      std::size_t bytes = 0;
+      for (std::size_t c = 0; c < classes; ++c) {
+        std::lock_guard<std::mutex> lock(s->mutexes[c]);
+        bytes += s->free[c].size() * classSize(c);
+      }
+      return bytes;
+    }
+
+  private:
+    std::shared_ptr<state> s;
+
+    static std::size_t sizeClass(std::size_t size) {
+      for (std::size_t c = 0; c < classes - 1; ++c) {
+        if (size <= classSize(c)) return c;
+      }
+      return classes - 1;
+    }
+  };
+}
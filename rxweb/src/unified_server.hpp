@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <rxcpp/rx.hpp>
+#include "rxweb/src/rxweb.hpp"
+#include "rxweb/src/server.hpp"
+#include "rxweb/src/wsserver.hpp"
+
+namespace rxweb {
+
+  /*
+    HTTP and WebSocket on one port.
+    The HTTP server owns the only acceptor, io_service and thread pool; requests carrying an Upgrade
+    header are handed to the WebSocket server in place, so it never listens on its own.
+    Both kinds of task go through one subject to middlewares indexed by task type: a task only
+    tries the middlewares registered under its type and those registered under "".
+    T: SimpleWeb::HTTP (upgrades to WS) || SimpleWeb::HTTPS (upgrades to WSS)
+  */
+  template<typename T>
+  class unified_server {
+    using RxWebTask = rxweb::task<T>;
+    using RxWsTask = rxweb::wstask<T>;
+    using RxWebMiddleware = rxweb::middleware<T>;
+    using RxWsMiddleware = rxweb::wsmiddleware<T>;
+
+    // One of the two is set.
+    struct envelope {
+      shared_ptr<const RxWebTask> web;
+      shared_ptr<const RxWsTask> ws;
+      std::size_t partition;
+    };
+
+  public:
+    // HTTP side: routes, paths, files, coalesce, recorder... Its middlewares and onNext are unused.
+    server<T> http;
+
+    // WebSocket side: routes, outboxes, send streams. Its middlewares are unused and it never listens.
+    wsserver<T> ws;
+
+    // Event loop subscriptions draining the subject. Tasks of one request or connection stay in order on one of them.
+    std::size_t partitions;
+
+    explicit unified_server(int _port, int _threads = 1) : http(_port, _threads), ws(_port, _threads), partitions(_threads) {}
+
+    explicit unified_server(
+      int _port,
+      int _threads,
+      const string _certFile,
+      const string _privateKeyFile
+    ) : http(_port, _threads, _certFile, _privateKeyFile), ws(_port, _threads, _certFile, _privateKeyFile), partitions(_threads) {}
+
+    // Register a middleware for tasks of this type, e.g. "ON_OPEN". "" receives every task.
+    // Tasks go straight to the partitioned subject, not through priority lanes: start() throws if
+    // http.laneWorkers or ws.laneWorkers is set, since those workers would never get work.
+    void use(const string& type, const RxWebMiddleware& m) {
+      webIndex[type].push_back(m);
+    }
+
+    void use(const string& type, const RxWsMiddleware& m) {
+      wsIndex[type].push_back(m);
+    }
+
+    void dispatch(const RxWebTask& t) {
+      sub.get_subscriber().on_next(envelope{ make_shared<RxWebTask>(t), nullptr, partitionOf(t.request.get()) });
+    }
+
+    void dispatch(const RxWsTask& t) {
+      sub.get_subscriber().on_next(envelope{ nullptr, make_shared<RxWsTask>(t), partitionOf(t.connection.get()) });
+    }
+
+    // Same as server<T>::respond, for onNext-style responders registered here.
+    void respond(const RxWebTask& t, const string& bytes) {
+      http.respond(t, bytes);
+    }
+
+    void start() {
+      if (http.laneWorkers > 0 || ws.laneWorkers > 0) {
+        throw std::invalid_argument("unified_server does not use priority lanes; leave laneWorkers at 0");
+      }
+
+      auto n = partitions > 0 ? partitions : 1;
+      for (std::size_t i = 0; i < n; ++i) {
+        sub.get_observable()
+          .filter([i, n](const envelope& e) { return e.partition % n == i; })
+          .observe_on(RxEventLoop)
+          .subscribe(
+            [this](const envelope& e) {
+              if (e.web) {
+                run(webIndex, *e.web);
+              } else {
+                run(wsIndex, *e.ws);
+              }
+            },
+            [](const std::exception_ptr& e) { rxweb::handleEptr(e); }
+          );
+      }
+
+      http.dispatcher = [this](const RxWebTask& t) { dispatch(t); };
+      ws.dispatcher = [this](const RxWsTask& t) { dispatch(t); };
+
+      ws.prepare();
+      http.onUpgrade = [this](unique_ptr<T>& socket, shared_ptr<typename SimpleWeb::ServerBase<T>::Request> request) {
+        ws.upgrade(socket, request);
+      };
+
+      http.start();
+    }
+
+    void stop() {
+      http.stop();
+    }
+
+  private:
+    rxcpp::subjects::subject<envelope> sub;
+    // Read-only once started.
+    unordered_map<string, vector<RxWebMiddleware>> webIndex;
+    unordered_map<string, vector<RxWsMiddleware>> wsIndex;
+
+    // Heap pointers are aligned, so drop the low bits before taking the modulo.
+    static std::size_t partitionOf(const void* p) {
+      return reinterpret_cast<std::uintptr_t>(p) >> 4;
+    }
+
+    template<typename Index, typename Task>
+    static void run(Index& index, const Task& t) {
+      runType(index, t.type, t);
+      if (!t.type.empty()) runType(index, "", t);
+    }
+
+    template<typename Index, typename Task>
+    static void runType(Index& index, const string& type, const Task& t) {
+      auto it = index.find(type);
+      if (it == index.end()) return;
+      for (auto& m : it->second) {
+        try {
+          if (!m.filterFunc || m.filterFunc(t)) m.subscribeFunc(t);
+        } catch (...) {
+          rxweb::handleEptr(std::current_exception());
+        }
+      }
+    }
+  };
+}
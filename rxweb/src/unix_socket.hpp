@@ -0,0 +1,142 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "server_http.hpp"
+
+namespace rxweb {
+
+  /*
+    SimpleWeb HTTP server that also accepts connections on a Unix domain socket.
+    Accepted sockets go through SimpleWeb's own request handling, so resources, middlewares and subjects
+    are shared with TCP. SimpleWeb sessions are typed on tcp sockets; the accepted descriptor is
+    assigned to one, which is fine for stream reads and writes. Request::remote_endpoint stays empty.
+  */
+  class unix_http_server : public SimpleWeb::Server<SimpleWeb::HTTP> {
+    using Base = SimpleWeb::Server<SimpleWeb::HTTP>;
+    using Local = SimpleWeb::asio::local::stream_protocol;
+
+  public:
+    // Path of the Unix domain socket. Empty for TCP only.
+    std::string socketPath;
+
+    // Keep accepting on config.port as well. When false, config.port is never bound.
+    bool tcp = true;
+
+    // Hides Server::start(): with tcp off, config.port is never bound and only the local acceptor runs.
+    void start() {
+      // A previous run's acceptor is closed; io threads are not running yet, so it can go.
+      local.reset();
+      if (tcp || socketPath.empty()) {
+        Base::start();
+        return;
+      }
+
+      if (!io_service) {
+        io_service = std::make_shared<SimpleWeb::asio::io_service>();
+        internal_io_service = true;
+      }
+      if (io_service->stopped()) io_service->reset();
+
+      listenLocal();
+
+      if (internal_io_service) {
+        threads.clear();
+        for (std::size_t c = 1; c < config.thread_pool_size; c++) {
+          threads.emplace_back([this]() { io_service->run(); });
+        }
+        if (config.thread_pool_size > 0) io_service->run();
+        for (auto& t : threads) t.join();
+      }
+    }
+
+    void stop() {
+      if (local) {
+        SimpleWeb::error_code ec;
+        local->close(ec);
+        if (isSocket(socketPath)) ::unlink(socketPath.c_str());
+      }
+      Base::stop();
+      // Server::stop() only stops the io_service when there is a TCP acceptor.
+      if (!acceptor && internal_io_service && io_service) io_service->stop();
+    }
+
+  protected:
+    // Called by Server::start() once io_service exists, and again after every TCP accept.
+    void accept() override {
+      if (!socketPath.empty() && !local) listenLocal();
+      Base::accept();
+    }
+
+  private:
+    std::unique_ptr<Local::acceptor> local;
+
+    // A stale socket from a previous run is replaced; anything else at the path is left alone.
+    void listenLocal() {
+      struct stat st;
+      if (::lstat(socketPath.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) throw std::invalid_argument(socketPath + " exists and is not a Unix domain socket");
+        ::unlink(socketPath.c_str());
+      }
+      local.reset(new Local::acceptor(*io_service, Local::endpoint(socketPath)));
+      acceptLocal();
+    }
+
+    static bool isSocket(const std::string& path) {
+      struct stat st;
+      return ::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode);
+    }
+
+    void acceptLocal() {
+      auto socket = std::make_shared<Local::socket>(*io_service);
+      local->async_accept(*socket, [this, socket](const SimpleWeb::error_code& ec) {
+        if (ec == SimpleWeb::asio::error::operation_aborted) return;
+        acceptLocal();
+        if (ec) return;
+
+        int fd = ::dup(socket->native_handle());
+        if (fd < 0) return;
+
+        auto connection = create_connection(*io_service);
+        auto lock = connection->handler_runner->continue_lock();
+        if (!lock) {
+          ::close(fd);
+          return;
+        }
+
+        SimpleWeb::error_code aec;
+        connection->socket->assign(SimpleWeb::asio::ip::tcp::v4(), fd, aec);
+        if (aec) {
+          ::close(fd);
+          return;
+        }
+
+        auto session = std::make_shared<Session>(config.max_request_streambuf_size, connection);
+        read_request_and_content(session);
+      });
+    }
+  };
+
+  // Picks the listener for a socket type: plain HTTP can also listen on a Unix domain socket.
+  template<typename T>
+  struct http_listener {
+    using type = SimpleWeb::Server<T>;
+
+    static void listen(type&, const std::string& socketPath, bool) {
+      if (!socketPath.empty()) throw std::invalid_argument("Unix domain sockets are only supported for plain HTTP");
+    }
+  };
+
+  template<>
+  struct http_listener<SimpleWeb::HTTP> {
+    using type = unix_http_server;
+
+    static void listen(type& s, const std::string& socketPath, bool tcp) {
+      s.socketPath = socketPath;
+      s.tcp = tcp;
+    }
+  };
+}
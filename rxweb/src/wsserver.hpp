@@ -1,15 +1,24 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <regex>
 #include <vector>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <rxcpp/rx.hpp>
 #include "server_ws.hpp"
 #include "rxweb/src/rxweb.hpp"
 #include "rxweb/src/subject.hpp"
 #include "rxweb/src/observer.hpp"
 #include "rxweb/src/subscriber.hpp"
+#include "rxweb/src/outbox.hpp"
+#include "rxweb/src/stream_pool.hpp"
+#include "rxweb/src/unix_socket.hpp"
 
 using namespace std;
 using json = nlohmann::json;
@@ -42,11 +51,17 @@ namespace rxweb {
     using OpenHandler = function<void(shared_ptr<typename SocketType::Connection>)>;
     using CloseHandler = function<void(shared_ptr<typename SocketType::Connection>, int, const string&)>;
     using WsAction = std::function<void(shared_ptr<typename SocketType::Connection>, shared_ptr<typename SocketType::Message>)>;
+    using Outbox = rxweb::outbox<T>;
 
     MessageHandler handleMesssge = [this](shared_ptr<typename SocketType::Connection> connection, shared_ptr<typename SocketType::Message> message) {
       cout << connection->path << endl;
       cout << connection->query_string << endl;
 
+      if (recorder) {
+        auto path = connection->query_string.empty() ? connection->path : connection->path + "?" + connection->query_string;
+        recorder->record(capture_kind::ws, connectionId(connection), "", path, peekContent(*message));
+      }
+
       for (auto& r : routes) {
         regex path_rx(r.expression);
         bool m = regex_search(connection->path, path_rx);
@@ -55,7 +70,7 @@ namespace rxweb {
     };
 
     ErrorHandler handleError = [this](shared_ptr<typename WsServer::Connection> connection, const SimpleWeb::error_code &ec) {
-      auto sub = getSubject();
+      releaseOutbox(connection);
       auto t = RxWsTask{ connection };
       json j = {
         { "errorCode", {
@@ -66,25 +81,25 @@ namespace rxweb {
       };
       t.data = make_shared<json>(j);
       t.type = "ON_ERROR";
-      sub.subscriber().on_next(t);
+      dispatch(t);
     };
 
     OpenHandler handleOpen = [this](shared_ptr<typename WsServer::Connection> connection) {
-      auto sub = getSubject();
+      openOutbox(connection);
       auto t = RxWsTask{ connection };
       t.type = "ON_OPEN";
-      sub.subscriber().on_next(t);
+      dispatch(t);
     };
 
     CloseHandler handleClose = [this](shared_ptr<typename WsServer::Connection> connection, int status, const string& reason) {
-      auto sub = getSubject();
+      releaseOutbox(connection);
       auto t = RxWsTask{ connection };
       json j = {
         { "status", status }
       };
       t.data = make_shared<json>(j);
       t.type = "ON_CLOSE";
-      sub.subscriber().on_next(t);
+      dispatch(t);
     };
 
   public:
@@ -100,6 +115,32 @@ namespace rxweb {
     // Endpoints
     // std::map<SocketType::Endpoint, WsAction> endpoints;
 
+    // Outbound queue limit per connection and what to do with a client that falls behind.
+    std::size_t highWaterMark = 1024;
+    slow_consumer_policy slowConsumerPolicy = slow_consumer_policy::drop;
+
+    // Outbound queue counters across all connections.
+    outbox_stats outboxStats;
+
+    // Reusable send streams. Lease with sendStreams.lease(sizeHint); they return when the write completes.
+    rxweb::stream_pool<typename SocketType::SendStream> sendStreams;
+
+    // Also accept WebSocket upgrades on this Unix domain socket path (plain WS only). Set tcpListener to false to skip config.port.
+    string unixSocket;
+    bool tcpListener = true;
+
+    // Optional traffic capture of every inbound message. Set before start().
+    shared_ptr<capture_writer> recorder;
+
+    // Worker threads serving the priority lanes. 0 dispatches straight to the subject on the event loop.
+    std::size_t laneWorkers = 0;
+
+    // Lane policy, weights and per-lane queue-wait stats.
+    rxweb::lanes<RxWsTask> lanes;
+
+    // Takes over dispatch when set, e.g. by a unified_server that owns the subject.
+    std::function<void(const RxWsTask&)> dispatcher;
+
     explicit wsserver(int _port, int _threads = 1) : port(_port), threads(_threads) {
       _server = make_shared<WsServer>();
       _server->config.port = port;
@@ -123,6 +164,11 @@ namespace rxweb {
       _server->config.thread_pool_size = threads;
     }
 
+    // Lane workers call into the subject, which is declared after them and would otherwise be destroyed first.
+    ~wsserver() {
+      lanes.stop();
+    }
+
     void applyRoutes() {
       std::for_each(routes.begin(), routes.end(), [&, this](const WsRoute<T>& r) {
         auto& endpoint = _server->endpoint[r.expression];
@@ -137,28 +183,126 @@ namespace rxweb {
       return sub;
     }
     
+    // Inbound tasks are classified here, so route actions should dispatch rather than call the subject directly.
     void dispatch(const RxWsTask& t) {
-      sub.subscriber().on_next(t);
+      if (dispatcher) {
+        dispatcher(t);
+      } else if (lanes.running()) {
+        lanes.push(classify(t), t);
+      } else {
+        sub.subscriber().on_next(t);
+      }
+    }
+
+    // Highest priority among the task's own class and the middlewares that would accept it.
+    priority_class classify(const RxWsTask& t) {
+      auto p = t.priority;
+      for (auto& m : middlewares) {
+        if (m.priority != priority_class::normal && higher(m.priority, p) != p && m.filterFunc(t)) p = m.priority;
+      }
+      return p;
     }
     
-    void broadcast(const string message) {
+    // Queue a message on the connection's outbox. Frames with the same key may be conflated under pressure.
+    // Sends to a connection that has already closed are dropped.
+    void send(shared_ptr<typename SocketType::Connection> connection, shared_ptr<typename SocketType::SendStream> send_stream, const string& key = "", unsigned char fin_rsv_opcode = 129) {
+      if (auto o = getOutbox(connection)) {
+        o->push(send_stream, key, fin_rsv_opcode);
+      } else {
+        ++outboxStats.dropped;
+      }
+    }
+
+    void send(shared_ptr<typename SocketType::Connection> connection, const string& message, const string& key = "") {
+      auto send_stream = sendStreams.lease(message.size());
+      *send_stream << message;
+      send(connection, send_stream, key);
+    }
+
+    // Send one message as fragments, e.g. rxweb::file_fragments(path). Other sends to the connection wait until it is done.
+    // chunkSize should match the generator's, so fragment streams are leased from the right pool class.
+    // Each fragment after the first is generated in the previous write's handler on a SimpleWeb io thread.
+    void sendFragments(shared_ptr<typename SocketType::Connection> connection, fragment_generator generator, bool binary = false, std::size_t chunkSize = 64 * 1024) {
+      if (auto o = getOutbox(connection)) {
+        o->push(generator, binary ? 130 : 129, chunkSize);
+      } else {
+        ++outboxStats.dropped;
+      }
+    }
+
+    void broadcast(const string message, const string& key = "") {
       for (auto& r : routes) {
         auto& endpoint = _server->endpoint[r.expression];
         for (auto& e : endpoint.get_connections()) {
-          auto send_stream = make_shared<typename SocketType::SendStream>();
-          *send_stream << message;
-          e->send(send_stream, [](const SimpleWeb::error_code &ec) {});
+          send(e, message, key);
         }
       }
     }
 
-    void start() {
+    // Outbound queue depth of every connection that has sent something.
+    map<const typename SocketType::Connection*, std::size_t> queueDepths() {
+      map<const typename SocketType::Connection*, std::size_t> depths;
+      std::lock_guard<std::mutex> lock(outboxesMutex);
+      for (auto& o : outboxes) depths[o.first] = o.second->depth();
+      return depths;
+    }
+
+    // Observers, lanes and endpoints, without listening. Connections then arrive through upgrade().
+    void prepare() {
       makeObserversAndSubscribeFromMiddlewares();
 
+      if (laneWorkers > 0) {
+        // Keyed by connection, so one connection's messages are still handled one at a time and in order.
+        lanes.start(laneWorkers, [this](RxWsTask& t) {
+          try {
+            sub.subscriber().on_next(t);
+          } catch (...) {
+            rxweb::handleEptr(std::current_exception());
+          }
+        }, [](const RxWsTask& t) {
+          return static_cast<std::size_t>(reinterpret_cast<std::uintptr_t>(t.connection.get()) >> 4);
+        });
+      }
+
       // Apply user-defined routes
       applyRoutes();
+    }
+
+    // Take over a socket whose HTTP upgrade request was read by another server, e.g. from Server<T>::on_upgrade.
+    void upgrade(unique_ptr<T>& socket, shared_ptr<typename SimpleWeb::ServerBase<T>::Request> request) {
+      auto connection = make_shared<typename SocketType::Connection>(std::move(socket));
+      connection->method = std::move(request->method);
+      connection->path = std::move(request->path);
+      connection->query_string = std::move(request->query_string);
+      connection->http_version = std::move(request->http_version);
+      connection->header = std::move(request->header);
+      _server->upgrade(connection);
+    }
+
+    void start() {
+      prepare();
+
+      if (!unixSocket.empty()) {
+        listenUnix(std::is_same<T, SimpleWeb::WS>());
+        if (!tcpListener) {
+          unixListener->start();
+          return;
+        }
+        unixThread = thread([this]() { unixListener->start(); });
+      }
 
       _server->start();
+
+      if (unixThread.joinable()) {
+        unixListener->stop();
+        unixThread.join();
+      }
+    }
+
+    void stop() {
+      if (unixListener && !tcpListener) unixListener->stop();
+      _server->stop();
+      lanes.stop();
     }
 
   private:
@@ -166,13 +310,67 @@ namespace rxweb {
     std::string certFile, privateKeyFile, socketType, endpoint;
     shared_ptr<WsServer> _server;
     rxweb::wssubject<T> sub;
+    shared_ptr<unix_http_server> unixListener;
+    thread unixThread;
+    std::mutex outboxesMutex;
+    unordered_map<const typename SocketType::Connection*, shared_ptr<Outbox>> outboxes;
+    // Capture ids. Connection addresses are reused after a connection is freed, so they cannot serve as ids.
+    unordered_map<const typename SocketType::Connection*, std::uint64_t> connectionIds;
+    std::uint64_t nextConnectionId = 1;
+
+    // Outboxes and ids live from on_open to on_close/on_error, so late sends cannot recreate one for a closed connection.
+    void openOutbox(shared_ptr<typename SocketType::Connection> connection) {
+      std::lock_guard<std::mutex> lock(outboxesMutex);
+      outboxes[connection.get()] = make_shared<Outbox>(connection, outboxStats, sendStreams, highWaterMark, slowConsumerPolicy);
+      connectionIds[connection.get()] = nextConnectionId++;
+    }
+
+    shared_ptr<Outbox> getOutbox(shared_ptr<typename SocketType::Connection> connection) {
+      std::lock_guard<std::mutex> lock(outboxesMutex);
+      auto it = outboxes.find(connection.get());
+      return it == outboxes.end() ? nullptr : it->second;
+    }
+
+    void releaseOutbox(shared_ptr<typename SocketType::Connection> connection) {
+      std::lock_guard<std::mutex> lock(outboxesMutex);
+      outboxes.erase(connection.get());
+      connectionIds.erase(connection.get());
+    }
+
+    // Assigned at on_open, unique for the life of the server. 0 if the connection is not open.
+    std::uint64_t connectionId(shared_ptr<typename SocketType::Connection> connection) {
+      std::lock_guard<std::mutex> lock(outboxesMutex);
+      auto it = connectionIds.find(connection.get());
+      return it == connectionIds.end() ? 0 : it->second;
+    }
+
+    // Upgrade requests arriving on the Unix domain socket are handed to the WebSocket server, same as TCP.
+    void listenUnix(std::true_type) {
+      unixListener = make_shared<unix_http_server>();
+      unixListener->config.thread_pool_size = threads;
+      http_listener<SimpleWeb::HTTP>::listen(*unixListener, unixSocket, false);
+
+      unixListener->on_upgrade = [this](unique_ptr<SimpleWeb::HTTP>& socket, shared_ptr<typename SimpleWeb::ServerBase<SimpleWeb::HTTP>::Request> request) {
+        upgrade(socket, request);
+      };
+    }
+
+    void listenUnix(std::false_type) {
+      throw std::invalid_argument("Unix domain sockets are only supported for plain WS");
+    }
 
     void makeObserversAndSubscribeFromMiddlewares() {
       // No subscription, observers does nothing.      
       // Create Observers that react to subscriber broadcast.
       std::for_each(middlewares.begin(), middlewares.end(), [&](auto& route) {
-        RxWsObserver observer(sub.observable(), route.filterFunc);
-        observer.subscribe(route.subscribeFunc);
+        // Lane workers already run off the io threads, so observers stay on the worker that dequeued the task.
+        if (laneWorkers > 0) {
+          RxWsObserver observer(sub.observable(), route.filterFunc, rxcpp::identity_current_thread());
+          observer.subscribe(route.subscribeFunc);
+        } else {
+          RxWsObserver observer(sub.observable(), route.filterFunc);
+          observer.subscribe(route.subscribeFunc);
+        }
       });
     }
   };
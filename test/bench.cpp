@@ -0,0 +1,299 @@
+/*
+  Request latency and throughput of rxweb::server over loopback TCP versus a Unix domain socket,
+  or CPU time and threads of separate HTTP and WebSocket servers versus one unified_server.
+
+    bench [requests] [connections]
+    bench unified [requests] [connections]
+*/
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <rxcpp/rx.hpp>
+#include "server_http.hpp"
+#include "client_ws.hpp"
+#include "rxweb/src/rxweb.hpp"
+#include "rxweb/src/server.hpp"
+#include "rxweb/src/wsserver.hpp"
+#include "rxweb/src/unified_server.hpp"
+
+using namespace std;
+namespace asio = SimpleWeb::asio;
+
+using WebTask = rxweb::task<SimpleWeb::HTTP>;
+using WsTask = rxweb::wstask<SimpleWeb::WS>;
+using WsClient = SimpleWeb::SocketClient<SimpleWeb::WS>;
+using Clock = std::chrono::steady_clock;
+
+struct result {
+  double rps;
+  double p50;
+  double p99;
+};
+
+// Keep-alive POSTs, one at a time, on an already connected socket.
+template<typename Socket>
+void roundTrips(Socket& socket, int n, vector<double>& latencies) {
+  const string request = "POST /bench HTTP/1.1\r\nHost: localhost\r\nContent-Length: 2\r\n\r\n{}";
+  asio::streambuf buffer;
+
+  for (int i = 0; i < n; ++i) {
+    auto start = Clock::now();
+    asio::write(socket, asio::buffer(request));
+
+    auto headerSize = asio::read_until(socket, buffer, "\r\n\r\n");
+    string header(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + headerSize);
+    buffer.consume(headerSize);
+
+    auto pos = header.find("Content-Length: ");
+    std::size_t length = pos == string::npos ? 0 : std::stoul(header.substr(pos + 16));
+    if (buffer.size() < length) asio::read(socket, buffer, asio::transfer_exactly(length - buffer.size()));
+    buffer.consume(length);
+
+    latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+  }
+}
+
+template<typename Connect>
+result run(int requests, int connections, Connect connect) {
+  vector<vector<double>> latencies(connections);
+  vector<thread> clients;
+
+  auto start = Clock::now();
+  for (int c = 0; c < connections; ++c) {
+    clients.emplace_back([&, c]() {
+      asio::io_service io;
+      auto socket = connect(io);
+      roundTrips(socket, requests / connections, latencies[c]);
+    });
+  }
+  for (auto& t : clients) t.join();
+  auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  vector<double> all;
+  for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+  std::sort(all.begin(), all.end());
+  if (all.empty()) return result{ 0, 0, 0 };
+  return result{ all.size() / seconds, all[all.size() / 2], all[static_cast<std::size_t>(0.99 * (all.size() - 1))] };
+}
+
+void print(const string& name, const result& r) {
+  cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+    << std::setw(12) << r.rps << " req/s"
+    << std::setw(10) << r.p50 << " us p50"
+    << std::setw(10) << r.p99 << " us p99" << endl;
+}
+
+const string ok = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nOK";
+
+// Two servers, two ports, two io_services and thread pools.
+void serveSplit(unsigned short port, int threads) {
+  rxweb::server<SimpleWeb::HTTP> http(port, threads);
+  rxweb::wsserver<SimpleWeb::WS> ws(port + 1, threads);
+
+  http.onNext = {
+    [](const WebTask& t)->bool { return true; },
+    [](const WebTask& t) { *(t.response) << ok; }
+  };
+
+  ws.routes = {
+    {
+      "^/ws/?$",
+      [&ws](shared_ptr<SimpleWeb::SocketServerBase<SimpleWeb::WS>::Connection> connection, shared_ptr<SimpleWeb::SocketServerBase<SimpleWeb::WS>::Message> message) {
+        auto t = WsTask{ connection, message };
+        t.type = "ECHO";
+        ws.dispatch(t);
+      }
+    }
+  };
+
+  ws.middlewares = {
+    {
+      [](const WsTask& t)->bool { return t.type == "ECHO"; },
+      [&ws](const WsTask& t) { ws.send(t.connection, t.message->string()); }
+    }
+  };
+
+  thread ws_thread([&ws]() { ws.start(); });
+  http.start();
+  ws_thread.join();
+}
+
+// One port; WebSocket upgrades are taken over by the HTTP server's io_service.
+void serveUnified(unsigned short port, int threads) {
+  rxweb::unified_server<SimpleWeb::HTTP> server(port, threads);
+
+  server.ws.routes = {
+    {
+      "^/ws/?$",
+      [&server](shared_ptr<SimpleWeb::SocketServerBase<SimpleWeb::WS>::Connection> connection, shared_ptr<SimpleWeb::SocketServerBase<SimpleWeb::WS>::Message> message) {
+        auto t = WsTask{ connection, message };
+        t.type = "ECHO";
+        server.dispatch(t);
+      }
+    }
+  };
+
+  server.use("", rxweb::middleware<SimpleWeb::HTTP>{
+    [](const WebTask& t)->bool { return true; },
+    [](const WebTask& t) { *(t.response) << ok; }
+  });
+
+  server.use("ECHO", rxweb::wsmiddleware<SimpleWeb::WS>{
+    [](const WsTask& t)->bool { return true; },
+    [&server](const WsTask& t) { server.ws.send(t.connection, t.message->string()); }
+  });
+
+  server.start();
+}
+
+// Echo round trips, one at a time, on one WebSocket connection.
+void wsRoundTrips(const string& url, int n) {
+  WsClient client(url);
+  auto received = make_shared<std::atomic<int>>(0);
+
+  auto sendOne = [](shared_ptr<WsClient::Connection> connection) {
+    auto send_stream = make_shared<WsClient::SendStream>();
+    *send_stream << "{}";
+    connection->send(send_stream);
+  };
+
+  client.on_open = [sendOne](shared_ptr<WsClient::Connection> connection) { sendOne(connection); };
+  client.on_message = [sendOne, received, n](shared_ptr<WsClient::Connection> connection, shared_ptr<WsClient::Message>) {
+    if (++*received < n) {
+      sendOne(connection);
+    } else {
+      connection->send_close(1000);
+    }
+  };
+
+  client.start();
+}
+
+int countThreads(pid_t pid) {
+  int n = 0;
+  auto dir = opendir(("/proc/" + std::to_string(pid) + "/task").c_str());
+  if (!dir) return 0;
+  while (auto e = readdir(dir)) {
+    if (e->d_name[0] != '.') ++n;
+  }
+  closedir(dir);
+  return n;
+}
+
+// Runs the server in a child process so its CPU time and threads are measured without the clients.
+template<typename Serve>
+void compare(const string& name, int requests, int connections, unsigned short httpPort, unsigned short wsPort, Serve serve) {
+  auto pid = fork();
+  if (pid == 0) {
+    freopen("/dev/null", "w", stdout);
+    serve();
+    _exit(0);
+  }
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  auto start = Clock::now();
+  vector<thread> clients;
+  for (int c = 0; c < connections; ++c) {
+    clients.emplace_back([&]() {
+      asio::io_service io;
+      asio::ip::tcp::socket socket(io);
+      socket.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string("127.0.0.1"), httpPort));
+      socket.set_option(asio::ip::tcp::no_delay(true));
+      vector<double> latencies;
+      roundTrips(socket, requests / connections, latencies);
+    });
+    clients.emplace_back([&]() {
+      wsRoundTrips("localhost:" + std::to_string(wsPort) + "/ws", requests / connections);
+    });
+  }
+  for (auto& t : clients) t.join();
+  auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  auto threads = countThreads(pid);
+  kill(pid, SIGKILL);
+  int status;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+
+  auto cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  auto ops = 2.0 * (requests / connections) * connections;
+
+  cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+    << std::setw(6) << threads << " threads"
+    << std::setw(10) << cpu * 1000 << " ms cpu"
+    << std::setw(8) << cpu * 1e6 / ops << " us cpu/op"
+    << std::setw(12) << ops / seconds << " op/s"
+    << std::setw(10) << usage.ru_nvcsw + usage.ru_nivcsw << " ctx switches" << endl;
+}
+
+int compareUnified(int requests, int connections) {
+  const unsigned short port = 8090;
+  const int threads = 4;
+
+  cout << requests << " HTTP requests and " << requests << " WebSocket echoes over " << connections << " connections each, "
+    << threads << " io threads per server" << endl;
+
+  compare("split", requests, connections, port, port + 1, [&]() { serveSplit(port, threads); });
+  compare("unified", requests, connections, port, port, [&]() { serveUnified(port, threads); });
+
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && string(argv[1]) == "unified") {
+    return compareUnified(argc > 2 ? std::stoi(argv[2]) : 20000, argc > 3 ? std::stoi(argv[3]) : 4);
+  }
+
+  int requests = argc > 1 ? std::stoi(argv[1]) : 20000;
+  int connections = argc > 2 ? std::stoi(argv[2]) : 4;
+  const unsigned short port = 8090;
+  const string socketPath = "/tmp/rxweb-bench.sock";
+
+  rxweb::server<SimpleWeb::HTTP> server(port, 4);
+  server.unixSocket = socketPath;
+
+  server.onNext = {
+    [](const WebTask& t)->bool { return true; },
+    [](const WebTask& t) {
+      *(t.response) << "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nOK";
+    }
+  };
+
+  thread server_thread([&server]() {
+    server.start();
+  });
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  cout << requests << " requests over " << connections << " connections" << endl;
+
+  print("tcp", run(requests, connections, [port](asio::io_service& io) {
+    asio::ip::tcp::socket socket(io);
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string("127.0.0.1"), port));
+    socket.set_option(asio::ip::tcp::no_delay(true));
+    return socket;
+  }));
+
+  print("unix", run(requests, connections, [&socketPath](asio::io_service& io) {
+    asio::local::stream_protocol::socket socket(io);
+    socket.connect(asio::local::stream_protocol::endpoint(socketPath));
+    return socket;
+  }));
+
+  server.stop();
+  server_thread.join();
+
+  return 0;
+}
@@ -0,0 +1,277 @@
+/*
+  Replays a capture log recorded by server/wsserver `recorder` against a running server.
+
+    replay run <capture> <host:port> [speed] [results]
+      speed 1 replays at the original pace, 2 twice as fast, 0 as fast as possible.
+      Latency is measured from each record's scheduled send time, so time spent waiting for a free
+      client counts against the server instead of silently disappearing (coordinated omission).
+      At speed 0 the schedule is the moment the record is read.
+      WebSocket connections are opened before the clock starts, so handshakes are not counted as latency.
+    replay diff <results-a> <results-b>
+*/
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "client_http.hpp"
+#include "client_ws.hpp"
+#include "rxweb/src/capture.hpp"
+
+using namespace std;
+
+using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
+using WsClient = SimpleWeb::SocketClient<SimpleWeb::WS>;
+using Clock = std::chrono::steady_clock;
+
+struct sample {
+  string kind;
+  double micros;
+  string path;
+};
+
+class samples {
+public:
+  void add(const string& kind, Clock::time_point sent, const string& path) {
+    auto micros = std::chrono::duration<double, std::micro>(Clock::now() - sent).count();
+    std::lock_guard<std::mutex> lock(mtx);
+    all.push_back(sample{ kind, micros, path });
+  }
+
+  vector<sample> get() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return all;
+  }
+
+private:
+  std::mutex mtx;
+  vector<sample> all;
+};
+
+// One replayed WebSocket connection. Replies are matched to sends in order.
+class ws_session {
+public:
+  ws_session(const string& url, samples& results_) : client(url), results(results_) {
+    client.on_open = [this](shared_ptr<WsClient::Connection> connection) {
+      std::lock_guard<std::mutex> lock(mtx);
+      conn = connection;
+      cv.notify_all();
+    };
+    client.on_message = [this](shared_ptr<WsClient::Connection>, shared_ptr<WsClient::Message>) {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (outstanding.empty()) return;
+      results.add("ws", outstanding.front().first, outstanding.front().second);
+      outstanding.pop_front();
+      cv.notify_all();
+    };
+    runner = thread([this]() { client.start(); });
+  }
+
+  // Returns false if the connection is not open by the deadline.
+  bool waitOpen(Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mtx);
+    return cv.wait_until(lock, deadline, [this]() { return conn != nullptr; });
+  }
+
+  // Never blocks the schedule: sends on a connection that did not open are skipped.
+  void send(const string& path, const string& body, Clock::time_point scheduled) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!conn) {
+      cout << "ws connection to " << path << " is not open" << endl;
+      return;
+    }
+    auto send_stream = make_shared<WsClient::SendStream>();
+    *send_stream << body;
+    outstanding.emplace_back(scheduled, path);
+    conn->send(send_stream);
+  }
+
+  void finish() {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait_for(lock, std::chrono::seconds(5), [this]() { return outstanding.empty(); });
+    }
+    client.stop();
+    runner.join();
+  }
+
+private:
+  WsClient client;
+  samples& results;
+  std::mutex mtx;
+  std::condition_variable cv;
+  shared_ptr<WsClient::Connection> conn;
+  deque<pair<Clock::time_point, string>> outstanding;
+  thread runner;
+};
+
+// Fixed pool of blocking HTTP clients.
+class http_pool {
+public:
+  http_pool(const string& host, std::size_t workers, samples& results) {
+    for (std::size_t i = 0; i < workers; ++i) {
+      threads.emplace_back([this, host, &results]() {
+        HttpClient client(host);
+        rxweb::capture_record r;
+        Clock::time_point scheduled;
+        while (pop(r, scheduled)) {
+          try {
+            auto response = client.request(r.method, r.path, r.body);
+            response->content.string();
+            results.add("http", scheduled, r.path);
+          } catch (const std::exception& e) {
+            cout << r.method << " " << r.path << " failed: " << e.what() << endl;
+          }
+        }
+      });
+    }
+  }
+
+  void push(const rxweb::capture_record& r, Clock::time_point scheduled) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      queue.emplace_back(r, scheduled);
+    }
+    cv.notify_one();
+  }
+
+  void finish() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      done = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads) t.join();
+  }
+
+private:
+  std::mutex mtx;
+  std::condition_variable cv;
+  deque<pair<rxweb::capture_record, Clock::time_point>> queue;
+  vector<thread> threads;
+  bool done = false;
+
+  bool pop(rxweb::capture_record& r, Clock::time_point& scheduled) {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this]() { return done || !queue.empty(); });
+    if (queue.empty()) return false;
+    r = std::move(queue.front().first);
+    scheduled = queue.front().second;
+    queue.pop_front();
+    return true;
+  }
+};
+
+double percentile(vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  return sorted[static_cast<std::size_t>(p * (sorted.size() - 1))];
+}
+
+map<string, vector<double>> byKind(const vector<sample>& all) {
+  map<string, vector<double>> kinds;
+  for (auto& s : all) kinds[s.kind].push_back(s.micros);
+  for (auto& k : kinds) std::sort(k.second.begin(), k.second.end());
+  return kinds;
+}
+
+void report(const vector<sample>& all) {
+  for (auto& k : byKind(all)) {
+    auto& v = k.second;
+    cout << k.first << ": n=" << v.size()
+      << " p50=" << percentile(v, 0.5) << "us"
+      << " p90=" << percentile(v, 0.9) << "us"
+      << " p99=" << percentile(v, 0.99) << "us"
+      << " max=" << (v.empty() ? 0 : v.back()) << "us" << endl;
+  }
+}
+
+vector<sample> load(const string& file) {
+  vector<sample> all;
+  ifstream in(file);
+  sample s;
+  while (in >> s.kind >> s.micros >> s.path) all.push_back(s);
+  return all;
+}
+
+int run(const string& capture, const string& host, double speed, const string& out) {
+  vector<rxweb::capture_record> records;
+  rxweb::capture_reader reader(capture);
+  rxweb::capture_record r;
+  while (reader.next(r)) records.push_back(r);
+  cout << "Replaying " << records.size() << " records against " << host << endl;
+
+  samples results;
+  http_pool http(host, 8, results);
+  map<std::uint64_t, unique_ptr<ws_session>> sessions;
+
+  for (auto& rec : records) {
+    if (rec.kind != rxweb::capture_kind::ws) continue;
+    auto& session = sessions[rec.connection];
+    if (!session) session.reset(new ws_session(host + rec.path, results));
+  }
+  auto deadline = Clock::now() + std::chrono::seconds(5);
+  for (auto& s : sessions) {
+    if (!s.second->waitOpen(deadline)) cout << "ws connection " << s.first << " did not open" << endl;
+  }
+
+  auto start = Clock::now();
+  for (auto& rec : records) {
+    auto scheduled = Clock::now();
+    if (speed > 0) {
+      scheduled = start + std::chrono::microseconds(static_cast<std::uint64_t>(rec.offset / speed));
+      std::this_thread::sleep_until(scheduled);
+    }
+    if (rec.kind == rxweb::capture_kind::http) {
+      http.push(rec, scheduled);
+      continue;
+    }
+    sessions[rec.connection]->send(rec.path, rec.body, scheduled);
+  }
+
+  http.finish();
+  for (auto& s : sessions) s.second->finish();
+
+  auto all = results.get();
+  report(all);
+
+  if (!out.empty()) {
+    ofstream o(out);
+    for (auto& s : all) o << s.kind << " " << std::fixed << std::setprecision(1) << s.micros << " " << s.path << "\n";
+  }
+  return 0;
+}
+
+int diff(const string& a, const string& b) {
+  auto ka = byKind(load(a));
+  auto kb = byKind(load(b));
+  for (auto& k : ka) {
+    auto& va = k.second;
+    auto& vb = kb[k.first];
+    cout << k.first << ":" << endl;
+    for (auto p : { 0.5, 0.9, 0.99, 1.0 }) {
+      auto x = percentile(va, p);
+      auto y = percentile(vb, p);
+      cout << "  p" << p * 100 << " " << x << "us -> " << y << "us"
+        << " (" << std::showpos << (x > 0 ? (y - x) * 100 / x : 0) << std::noshowpos << "%)" << endl;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc >= 4 && string(argv[1]) == "run") {
+    return run(argv[2], argv[3], argc > 4 ? std::stod(argv[4]) : 1.0, argc > 5 ? argv[5] : "");
+  }
+  if (argc == 4 && string(argv[1]) == "diff") {
+    return diff(argv[2], argv[3]);
+  }
+  cout << "usage: replay run <capture> <host:port> [speed] [results]" << endl;
+  cout << "       replay diff <results-a> <results-b>" << endl;
+  return 1;
+}
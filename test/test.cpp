@@ -8,7 +8,9 @@
 #include "client_http.hpp"
 #include "rxweb/src/rxweb.hpp"
 #include "rxweb/src/server.hpp"
+#include "rxweb/src/static_server.hpp"
 #include "rxweb/src/wsserver.hpp"
+#include "rxweb/src/unified_server.hpp"
 #include "client_ws.hpp"
 
 using namespace std;
@@ -54,29 +56,319 @@ shared_ptr<WsClient> makeClient(const string url, const string message) {
   return client;
 }
 
+// Compile-time middlewares for rxweb::static_server.
+struct StaticAppend {
+  using WebTask = rxweb::task<SimpleWeb::HTTP>;
+
+  bool filter(const WebTask& t) const { return t.type == "parse"; }
+
+  template<typename Server>
+  void operator()(Server& server, const WebTask& t) const {
+    auto cp = t;
+    *(cp.ss) << "static\n";
+    cp.type = "respond";
+    server.dispatch(cp);
+  }
+};
+
+struct StaticRespond {
+  using WebTask = rxweb::task<SimpleWeb::HTTP>;
+
+  bool filter(const WebTask& t) const { return t.type == "respond"; }
+
+  template<typename Server>
+  void operator()(Server&, const WebTask& t) const {
+    auto s = (*(t.ss)).str();
+    *(t.response) << "HTTP/1.1 200 OK\r\nContent-Length: " << s.size() << "\r\n\r\n" << s;
+  }
+};
+
+int testStaticServer() {
+  using WebTask = rxweb::task<SimpleWeb::HTTP>;
+  using SocketType = SimpleWeb::ServerBase<SimpleWeb::HTTP>;
+
+  rxweb::static_server<SimpleWeb::HTTP, StaticAppend, StaticRespond> server(8080, 1);
+
+  server.routes = {
+    {
+      "^/static/?$",
+      "POST",
+      [&](std::shared_ptr<SocketType::Response> response, std::shared_ptr<SocketType::Request> request) {
+        auto t = WebTask{ request, response };
+        t.type = "parse";
+        server.dispatch(t);
+      }
+    }
+  };
+
+  thread server_thread([&server]() {
+    server.start();
+  });
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  int failures = 0;
+
+  try {
+    HttpClient client("localhost:8080");
+    auto body = client.request("POST", "/static", "{}")->content.string();
+    std::cout << "Static -> " << body << std::endl;
+    if (body != "static\n") ++failures;
+  } catch (const std::exception& e) {
+    std::cout << e.what() << std::endl;
+    ++failures;
+  }
+
+  server.stop();
+  server_thread.join();
+
+  return failures;
+}
+
+int testUnifiedServer() {
+  using WebTask = rxweb::task<SimpleWeb::HTTP>;
+  using WebSocketTask = rxweb::wstask<SimpleWeb::HTTP>;
+  using WebSocketType = SimpleWeb::SocketServerBase<SimpleWeb::WS>;
+
+  // HTTP and WebSocket on port 8080, one thread pool.
+  rxweb::unified_server<SimpleWeb::HTTP> server(8080, 2);
+
+  server.ws.routes = {
+    {
+      "^/ws/?$",
+      [&](std::shared_ptr<WebSocketType::Connection> connection, std::shared_ptr<WebSocketType::Message> message) {
+        auto t = WebSocketTask{ connection, message };
+        t.type = "ECHO";
+        server.dispatch(t);
+      }
+    }
+  };
+
+  server.use("", rxweb::middleware<SimpleWeb::HTTP>{
+    [](const WebTask& t)->bool { return true; },
+    [&server](const WebTask& t) {
+      server.respond(t, "HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nhttp");
+    }
+  });
+
+  server.use("ECHO", rxweb::wsmiddleware<SimpleWeb::HTTP>{
+    [](const WebSocketTask& t)->bool { return true; },
+    [&server](const WebSocketTask& t) {
+      server.ws.send(t.connection, "ws: " + t.message->string());
+    }
+  });
+
+  server.use("ON_OPEN", rxweb::wsmiddleware<SimpleWeb::HTTP>{
+    [](const WebSocketTask& t)->bool { return true; },
+    [](const WebSocketTask& t) { cout << "Server: ON_OPEN " << t.connection.get() << endl; }
+  });
+
+  thread server_thread([&server]() {
+    server.start();
+  });
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  int failures = 0;
+
+  try {
+    HttpClient client("localhost:8080");
+    auto body = client.request("POST", "/", "{}")->content.string();
+    std::cout << "Unified HTTP -> " << body << std::endl;
+    if (body != "http") ++failures;
+  } catch (const std::exception& e) {
+    std::cout << e.what() << std::endl;
+    ++failures;
+  }
+
+  // The WebSocket upgrade goes through the same port.
+  WsClient client("localhost:8080/ws");
+  string echoed;
+  client.on_open = [](shared_ptr<WsClient::Connection> connection) {
+    auto send_stream = make_shared<WsClient::SendStream>();
+    *send_stream << "Hello";
+    connection->send(send_stream);
+  };
+  client.on_message = [&echoed](shared_ptr<WsClient::Connection> connection, shared_ptr<WsClient::Message> message) {
+    echoed = message->string();
+    connection->send_close(1000);
+  };
+  thread client_thread([&client]() {
+    client.start();
+  });
+  client_thread.join();
+
+  std::cout << "Unified WS -> " << echoed << std::endl;
+  if (echoed != "ws: Hello") ++failures;
+
+  server.stop();
+  server_thread.join();
+
+  return failures;
+}
+
+// ETag, Range, traversal and 404 handling of server.files.
+int testStaticFiles() {
+  rxweb::server<SimpleWeb::HTTP> server(8080, 1);
+
+  system("mkdir -p /tmp/rxweb-www && printf 'hello world' > /tmp/rxweb-www/index.html && printf secret > /tmp/rxweb-secret");
+  server.files = make_shared<rxweb::static_files<SimpleWeb::HTTP>>("/tmp/rxweb-www", "/static/");
+
+  thread server_thread([&server]() {
+    server.start();
+  });
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  int failures = 0;
+  auto expect = [&failures](const string& name, const string& got, const string& want) {
+    std::cout << name << " -> " << got << std::endl;
+    if (got.compare(0, want.size(), want) != 0) {
+      std::cout << "  expected " << want << std::endl;
+      ++failures;
+    }
+  };
+
+  try {
+    HttpClient client("localhost:8080");
+    auto r = client.request("GET", "/static/");
+    expect("index", r->status_code, "200");
+    expect("body", r->content.string(), "hello world");
+
+    auto etag = r->header.find("ETag")->second;
+    expect("If-None-Match", client.request("GET", "/static/index.html", "", { { "If-None-Match", etag } })->status_code, "304");
+
+    r = client.request("GET", "/static/index.html", "", { { "Range", "bytes=-5" } });
+    expect("Range", r->status_code, "206");
+    expect("Range body", r->content.string(), "world");
+    expect("Range past end", client.request("GET", "/static/index.html", "", { { "Range", "bytes=50-" } })->status_code, "416");
+
+    expect("traversal", client.request("GET", "/static/%2e%2e/rxweb-secret")->status_code, "404");
+    expect("missing", client.request("GET", "/static/missing.txt")->status_code, "404");
+    expect("outside prefix", client.request("GET", "/other")->status_code, "200");
+  } catch (const std::exception& e) {
+    std::cout << e.what() << std::endl;
+    ++failures;
+  }
+
+  server.stop();
+  server_thread.join();
+
+  return failures;
+}
+
+// Two threads send to one connection while its writes complete; each sender's frames must arrive in order.
+int testOutboxOrder() {
+  using WebSocketType = SimpleWeb::SocketServerBase<SimpleWeb::WS>;
+  using WebSocketTask = rxweb::wstask<SimpleWeb::WS>;
+
+  const int perSender = 500;
+  rxweb::wsserver<SimpleWeb::WS> server(8080, 2);
+
+  // Small enough that frames wait in the outbox and are flushed from write completions on the io threads.
+  server.highWaterMark = 8;
+
+  server.routes = {
+    {
+      "^/order/?$",
+      [&](std::shared_ptr<WebSocketType::Connection> connection, std::shared_ptr<WebSocketType::Message> message) {
+        auto t = WebSocketTask{ connection, message };
+        t.type = "ORDER";
+        server.dispatch(t);
+      }
+    }
+  };
+
+  server.middlewares = {
+    {
+      [](const WebSocketTask& t)->bool { return t.type == "ORDER"; },
+      [&server, perSender](const WebSocketTask& t) {
+        auto sender = [&server, &t, perSender](const string& name) {
+          for (int i = 0; i < perSender; ++i) {
+            // Stay under the drop threshold: at most highWaterMark in flight plus a few waiting.
+            while (server.queueDepths()[t.connection.get()] >= server.highWaterMark + 4) std::this_thread::yield();
+            server.send(t.connection, name + ":" + std::to_string(i));
+          }
+        };
+        thread a(sender, "a"), b(sender, "b");
+        a.join();
+        b.join();
+      }
+    }
+  };
+
+  thread server_thread([&server]() {
+    server.start();
+  });
+
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  int failures = 0;
+  map<string, int> next;
+  int received = 0;
+
+  WsClient client("localhost:8080/order");
+  client.on_open = [](shared_ptr<WsClient::Connection> connection) {
+    auto send_stream = make_shared<WsClient::SendStream>();
+    *send_stream << "go";
+    connection->send(send_stream);
+  };
+  client.on_message = [&](shared_ptr<WsClient::Connection> connection, shared_ptr<WsClient::Message> message) {
+    auto s = message->string();
+    auto colon = s.find(':');
+    auto name = s.substr(0, colon);
+    auto i = std::stoi(s.substr(colon + 1));
+    if (i != next[name]) {
+      std::cout << "Out of order: " << s << ", expected " << name << ":" << next[name] << std::endl;
+      ++failures;
+    }
+    next[name] = i + 1;
+    if (++received == 2 * perSender) connection->send_close(1000);
+  };
+  thread client_thread([&client]() {
+    client.start();
+  });
+  client_thread.join();
+
+  std::cout << "Outbox order -> received " << received << " dropped " << server.outboxStats.dropped << std::endl;
+  if (received != 2 * perSender || server.outboxStats.dropped != 0) ++failures;
+
+  server.stop();
+  server_thread.join();
+
+  return failures;
+}
+
 int testWebSocketServer() {
   using WebSocketType = SimpleWeb::SocketServerBase<SimpleWeb::WS>;
   using WebSocketTask = rxweb::wstask<SimpleWeb::WS>;
 
   rxweb::wsserver<SimpleWeb::WS> server(8080, 1);
 
+  // Control messages jump ahead of bulk echo traffic.
+  server.laneWorkers = 2;
+
   server.routes = {
     {
       "^/string/?$",
       [&](std::shared_ptr<WebSocketType::Connection> connection, std::shared_ptr<WebSocketType::Message> message) {
-        auto sub = server.getSubject();
         auto t = WebSocketTask{ connection, message };
-        auto msg = message->string();
-        t.ss = make_shared<stringstream>(msg);
+        // Consume the message chunk by chunk; only a byte count and a short preview are kept.
+        std::size_t bytes = 0;
+        string preview;
+        t.chunks(4096).subscribe([&bytes, &preview](const string& chunk) {
+          bytes += chunk.size();
+          if (preview.size() < 64) preview += chunk.substr(0, 64 - preview.size());
+        });
+        *(t.ss) << bytes << " bytes: " << preview;
 
         t.type = "RESPOND";
-        sub.subscriber().on_next(t);
+        server.dispatch(t);
       }
     },
     {
       "^/json/?$",
       [&](std::shared_ptr<WebSocketType::Connection> connection, std::shared_ptr<WebSocketType::Message> message) {
-        auto sub = server.getSubject();
         auto t = WebSocketTask{ connection, message };
         auto msg = message->string();
         
@@ -89,7 +381,7 @@ int testWebSocketServer() {
         }
 
         t.type = "RESPOND";
-        sub.subscriber().on_next(t);
+        server.dispatch(t);
 
         server.broadcast("Broadcasting from /json path");
       }
@@ -107,18 +399,17 @@ int testWebSocketServer() {
 
         cout << "Server: Sending message \"" << message_str << "\" to " << t.connection.get() << endl;
 
-        auto send_stream = make_shared<WebSocketType::SendStream>();
-        *send_stream << message_str;
-        // connection->send is an asynchronous function
-        t.connection->send(send_stream, [](const SimpleWeb::error_code &ec) {
-          if (ec) {
-            cout << "Server: Error sending message. " <<
-              // See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
-              "Error: " << ec << ", error message: " << ec.message() << endl;
-          }
-        });
+        // Queued on the connection's outbox, written asynchronously.
+        server.send(t.connection, message_str);
       }
     },
+    {
+      [](const WebSocketTask& t)->bool { return t.type == "ON_OPEN" || t.type == "ON_CLOSE"; },
+      [](const WebSocketTask& t) {
+        cout << "Server: " << t.type << " " << t.connection.get() << endl;
+      },
+      rxweb::priority_class::critical
+    },
     {
       [](const WebSocketTask& t)->auto { return t.type == "BROADCAST"; },
       [&server](const WebSocketTask& t) {
@@ -160,10 +451,14 @@ int testWebSocketServer() {
   return 0;
 }
 
-int main() {
-  {
-    return testWebSocketServer();
-  }
+// testing [ws|order|static|files|unified|http]
+int main(int argc, char* argv[]) {
+  string which = argc > 1 ? argv[1] : "ws";
+  if (which == "ws") return testWebSocketServer();
+  if (which == "order") return testOutboxOrder();
+  if (which == "static") return testStaticServer();
+  if (which == "files") return testStaticFiles();
+  if (which == "unified") return testUnifiedServer();
 
   using WebTask = rxweb::task<SimpleWeb::HTTP>;
   using SocketType = SimpleWeb::ServerBase<SimpleWeb::HTTP>;
@@ -175,24 +470,78 @@ int main() {
       "/hl7",
       "POST",
       [&](std::shared_ptr<SocketType::Response> response, std::shared_ptr<SocketType::Request> request) {
-        auto sub = server.getSubject();
         auto t = WebTask{ request, response };
-        t.type = "parse";
-        sub.subscriber().on_next(t);
+        *(t.ss) << "hl7\n";
+        t.type = "respond";
+        server.dispatch(t);
       }
     }
   };
 
+  // The radix tree is tried first; "/hl7" is only reached through the regex fallback.
+  server.paths = {
+    {
+      "/users/me",
+      "POST",
+      [&](WebTask& t) {
+        *(t.ss) << "me\n";
+        t.type = "respond";
+        server.dispatch(t);
+      }
+    },
+    {
+      "/users/:id",
+      "POST",
+      [&](WebTask& t) {
+        *(t.ss) << "user " << t.params["id"] << "\n";
+        t.type = "respond";
+        server.dispatch(t);
+      }
+    },
+    {
+      "/users/:id",
+      "PUT",
+      [&](WebTask& t) {
+        *(t.ss) << "updated " << t.params["id"] << "\n";
+        t.type = "respond";
+        server.dispatch(t);
+      }
+    },
+    // Identical concurrent POSTs share one pipeline run; the "hold" middleware keeps the leader in flight.
+    {
+      "/string",
+      "POST",
+      [&](WebTask& t) {
+        *(t.ss) << t.request->content.string();
+        t.type = "hold";
+        server.dispatch(t);
+      },
+      true
+    }
+  };
+
   server.onNext = {
-    [](const WebTask& t)->bool { return (t.request->path.rfind("/string") != std::string::npos && t.type == "respond"); },
-    [](const WebTask& t) {
+    [](const WebTask& t)->bool { return t.type == "respond"; },
+    [&server](const WebTask& t) {
       const std::string ok("OK");
       cout << "SIZE " << (*t.ss).str() << endl;;
-      *(t.response) << "HTTP/1.1 200 OK\r\nContent-Length: " << ((*(t.ss)).str().size() + ok.length()) << "\r\n\r\n" << ok << (*(t.ss)).str();
+      stringstream out;
+      out << "HTTP/1.1 200 OK\r\nContent-Length: " << ((*(t.ss)).str().size() + ok.length()) << "\r\n\r\n" << ok << (*(t.ss)).str();
+      server.respond(t, out.str());
     }
   };
 
   server.middlewares = {
+    {
+      [](const WebTask& t)->bool { return t.type == "hold"; },
+      [&server](const WebTask& t) {
+        auto cp = t;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        cp.type = "respond";
+        server.dispatch(cp);
+      }
+    },
     {
       [](const WebTask& t)->bool { return (t.request->path.rfind("/string") == std::string::npos && t.type == "1"); },
       [&server](const WebTask& t) {
@@ -242,23 +591,54 @@ int main() {
   // Wait for server to start so that the client can connect
   std::this_thread::sleep_for(std::chrono::seconds(1));
     
+  int failures = 0;
+  auto expect = [&failures](const string& name, const string& got, const string& want) {
+    std::cout << name << " -> " << got << std::endl;
+    if (got.compare(0, want.size(), want) != 0) {
+      std::cout << "  expected " << want << std::endl;
+      ++failures;
+    }
+  };
+
+  // Static segment before :param, :param, regex fallback, and a miss on a verb with no default resource.
+  try {
+    HttpClient client("localhost:8080");
+    expect("/users/me", client.request("POST", "/users/me")->content.string(), "OKme\n");
+    expect("/users/42", client.request("POST", "/users/42")->content.string(), "OKuser 42\n");
+    expect("PUT /users/7", client.request("PUT", "/users/7")->content.string(), "OKupdated 7\n");
+    expect("/hl7", client.request("POST", "/hl7")->content.string(), "OKhl7\n");
+    expect("miss", client.request("PUT", "/accounts/7")->status_code, "404");
+  } catch (const std::exception& e) {
+    std::cout << e.what() << std::endl;
+    ++failures;
+  }
+
   // Tests below
   std::string json_string = "{\"firstName\": \"John\",\"lastName\": \"Smith\",\"age\": 25}";
   
   // Use async++
-  async::parallel_for(async::irange(0, 1), [&json_string](int x) {
+  vector<string> bodies(8);
+  async::parallel_for(async::irange(0, 8), [&json_string, &bodies](int x) {
     try {
       HttpClient client("localhost:8080");
       auto r2 = client.request("POST", "/string", json_string);
-      std::cout << "Request " << x << " -> " << r2->content.rdbuf() << "\r\n\r\n";      
+      bodies[x] = r2->content.string();
+      std::cout << "Request " << x << " -> " << bodies[x] << "\r\n\r\n";
     } catch (const std::exception& e) {
       std::cout << e.what() << std::endl;
     }
   });
   
+  std::cout << "executed " << server.flights.executed << " collapsed " << server.flights.collapsed << std::endl;
+  for (auto& b : bodies) {
+    if (b != "OK" + json_string) ++failures;
+  }
+  if (server.flights.collapsed == 0) ++failures;
+
   // Get server thread info
   std::cout << "server thread -> " << hasher(server_thread.get_id()) << std::endl;
+  server.stop();
   server_thread.join();
   
-  return 0;
+  return failures;
 }
\ No newline at end of file